@@ -2,6 +2,9 @@ set(ARROW_LIBS_DIR "${CMAKE_BINARY_DIR}/arrow/install/lib")
 set(ARROW_INCLUDE_DIR "${CMAKE_BINARY_DIR}/arrow/install/include")
 set(SNAPPY_LIB_DIR "${CMAKE_BINARY_DIR}/arrow/build/snappy_ep/src/snappy_ep-install/lib/")
 set(THRIFT_LIB_DIR "${CMAKE_BINARY_DIR}/arrow/build/thrift_ep-install/lib/")
+set(LZ4_LIB_DIR "${CMAKE_BINARY_DIR}/arrow/build/lz4_ep-prefix/src/lz4_ep/lib/")
+set(ZSTD_LIB_DIR "${CMAKE_BINARY_DIR}/arrow/build/zstd_ep-install/lib/"
+        "${CMAKE_BINARY_DIR}/arrow/build/zstd_ep-install/lib64/")
 set(AWS_LIB_DIR "${CMAKE_BINARY_DIR}/arrow/build/awssdk_ep-install/lib/")
 
 find_library(LIBARROW_LIBRARY NAMES arrow
@@ -14,6 +17,10 @@ find_library(LIBTHRIFT_LIBRARY NAMES thrift
         HINTS ${THRIFT_LIB_DIR})
 find_library(LIBTHRIFT_LIBRARY NAMES thrift
         HINTS ${THRIFT_LIB_DIR})
+find_library(LIBLZ4_LIBRARY NAMES lz4
+        HINTS ${LZ4_LIB_DIR})
+find_library(LIBZSTD_LIBRARY NAMES zstd
+        HINTS ${ZSTD_LIB_DIR})
 
 # aws stuff
 find_library(LIBAWS_S3_LIBRARY NAMES aws-cpp-sdk-s3
@@ -48,6 +55,12 @@ set_property(TARGET arrow::parquet PROPERTY INTERFACE_LINK_LIBRARIES ${LIBPARQUE
 add_library(arrow::snappy INTERFACE IMPORTED)
 set_property(TARGET arrow::snappy PROPERTY INTERFACE_LINK_LIBRARIES ${LIBSNAPPY_LIBRARY})
 
+add_library(arrow::lz4 INTERFACE IMPORTED)
+set_property(TARGET arrow::lz4 PROPERTY INTERFACE_LINK_LIBRARIES ${LIBLZ4_LIBRARY})
+
+add_library(arrow::zstd INTERFACE IMPORTED)
+set_property(TARGET arrow::zstd PROPERTY INTERFACE_LINK_LIBRARIES ${LIBZSTD_LIBRARY})
+
 add_library(arrow::thrift INTERFACE IMPORTED)
 set_property(TARGET arrow::thrift PROPERTY INTERFACE_LINK_LIBRARIES ${LIBTHRIFT_LIBRARY})
 
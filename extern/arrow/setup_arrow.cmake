@@ -7,9 +7,9 @@ set(PARQUET_ARGS " -DARROW_WITH_BROTLI=OFF"
         " -DARROW_WITH_SNAPPY=ON"
         " -DARROW_WITH_ZLIB=OFF")
 
-set(ARROW_CMAKE_ARGS " -DARROW_WITH_LZ4=OFF"
+set(ARROW_CMAKE_ARGS " -DARROW_WITH_LZ4=ON"
         " -DARROW_BUILD_SHARED=OFF"
-        " -DARROW_WITH_ZSTD=OFF"
+        " -DARROW_WITH_ZSTD=ON"
         " -DARROW_BUILD_STATIC=ON"
         " -DARROW_BUILD_TESTS=OFF"
         " -DARROW_TEST_MEMCHECK=OFF"
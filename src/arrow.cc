@@ -2,6 +2,7 @@
 
 #include <filesystem>
 #include <iostream>
+#include <numeric>
 
 #include "arrow/api.h"
 #include "arrow/filesystem/localfs.h"
@@ -46,101 +47,190 @@ std::shared_ptr<arrow::Buffer> serialize(const std::shared_ptr<arrow::RecordBatc
     return buff;
 }
 
+std::shared_ptr<arrow::DataType> get_type(const AttributeValue &value) {
+    std::shared_ptr<arrow::DataType> type;
+    std::visit(overloaded{[&type](uint8_t) { type = arrow::uint8(); },
+                          [&type](uint16_t) { type = arrow::uint16(); },
+                          [&type](uint32_t) { type = arrow::uint32(); },
+                          [&type](uint64_t) { type = arrow::uint64(); },
+                          [&type](bool) { type = arrow::boolean(); },
+                          [&type](const std::string &) { type = arrow::utf8(); }},
+               value);
+    return type;
+}
+
 void get_schema(const std::map<std::string, AttributeValue> &values,
                 std::vector<std::shared_ptr<arrow::Field>> &fields) {
     for (auto const &[name, v] : values) {
-        std::shared_ptr<arrow::DataType> type;
-        std::visit(overloaded{[&type](uint8_t) { type = arrow::uint8(); },
-                              [&type](uint16_t) { type = arrow::uint16(); },
-                              [&type](uint32_t) { type = arrow::uint32(); },
-                              [&type](uint64_t) { type = arrow::uint64(); },
-                              [&type](bool) { type = arrow::boolean(); },
-                              [&type](const std::string &) { type = arrow::utf8(); }},
-                   v);
-        auto field = std::make_shared<arrow::Field>(name, type);
+        auto field = std::make_shared<arrow::Field>(name, get_type(v));
         fields.emplace_back(field);
     }
 }
 
-template <typename T>
-void serialize(const T *batch, std::vector<std::shared_ptr<arrow::Array>> &arrays) {
-    auto *pool = arrow::default_memory_pool();
-    std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders;
-    // initialize the builders based on the index sequence
-    {
-        auto const &event = *(*batch)[0];
-        for (auto const &[name, v] : event.values()) {
-            // visit the variant
-            std::visit(
-                overloaded{[pool, &builders](uint8_t) {
-                               builders.emplace_back(std::make_unique<arrow::UInt8Builder>(pool));
-                           },
-                           [pool, &builders](uint16_t) {
-                               builders.emplace_back(std::make_unique<arrow::UInt16Builder>(pool));
-                           },
-                           [pool, &builders](uint32_t) {
-                               builders.emplace_back(std::make_unique<arrow::UInt32Builder>(pool));
-                           },
-                           [pool, &builders](uint64_t) {
-                               builders.emplace_back(std::make_unique<arrow::UInt64Builder>(pool));
-                           },
-                           [pool, &builders](bool) {
-                               builders.emplace_back(std::make_unique<arrow::BooleanBuilder>(pool));
-                           },
-                           [pool, &builders](const std::string &) {
-                               builders.emplace_back(std::make_unique<arrow::StringBuilder>(pool));
-                           }},
-                v);
+template <typename CType, typename BuilderType>
+std::shared_ptr<arrow::Array> build_column(const AttributeValue *const *cells, uint64_t num_rows) {
+    BuilderType builder(arrow::default_memory_pool());
+    if (!builder.Reserve(static_cast<int64_t>(num_rows)).ok()) return nullptr;
+    if constexpr (std::is_same_v<CType, std::string>) {
+        uint64_t data_size = 0;
+        for (uint64_t i = 0; i < num_rows; i++) {
+            auto const *value = cells[i] ? std::get_if<std::string>(cells[i]) : nullptr;
+            if (value) data_size += value->size();
         }
+        if (!builder.ReserveData(static_cast<int64_t>(data_size)).ok()) return nullptr;
     }
-    // write each row
-    for (auto const &event : *batch) {
-        auto const &values = event->values();
-        uint64_t idx = 0;
-        for (auto const &[name, value] : values) {
-            auto *ptr = builders[idx++].get();
-            // visit the variant
-            std::visit(overloaded{[ptr](uint8_t arg) {
-                                      auto *p = reinterpret_cast<arrow::UInt8Builder *>(ptr);
-                                      (void)p->Append(arg);
-                                  },
-                                  [ptr](uint16_t arg) {
-                                      auto *p = reinterpret_cast<arrow::UInt16Builder *>(ptr);
-                                      (void)p->Append(arg);
-                                  },
-                                  [ptr](uint32_t arg) {
-                                      auto *p = reinterpret_cast<arrow::UInt32Builder *>(ptr);
-                                      (void)p->Append(arg);
-                                  },
-                                  [ptr](uint64_t arg) {
-                                      auto *p = reinterpret_cast<arrow::UInt64Builder *>(ptr);
-                                      (void)p->Append(arg);
-                                  },
-                                  [ptr](bool arg) {
-                                      auto *p = reinterpret_cast<arrow::BooleanBuilder *>(ptr);
-                                      (void)p->Append(arg);
-                                  },
-                                  [ptr](const std::string &arg) {
-                                      auto *p = reinterpret_cast<arrow::StringBuilder *>(ptr);
-                                      (void)p->Append(arg);
-                                  }},
-
-                       value);
+    for (uint64_t i = 0; i < num_rows; i++) {
+        auto const *value = cells[i] ? std::get_if<CType>(cells[i]) : nullptr;
+        if (value) {
+            builder.UnsafeAppend(*value);
+        } else {
+            builder.UnsafeAppendNull();
         }
     }
-    // arrays
-    arrays.reserve(builders.size());
-    for (auto &builder : builders) {
+    std::shared_ptr<arrow::Array> array;
+    if (!builder.Finish(&array).ok()) return nullptr;
+    return array;
+}
+
+// builds one array per column out of the column-major cells. column types are taken from ref
+void build_columns(const std::vector<const AttributeValue *> &cells, uint64_t num_rows,
+                   const std::vector<const AttributeValue *> &ref,
+                   std::vector<std::shared_ptr<arrow::Array>> &arrays) {
+    arrays.reserve(arrays.size() + ref.size());
+    for (uint64_t column = 0; column < ref.size(); column++) {
+        auto const *column_cells = cells.data() + column * num_rows;
+        auto const &v = *ref[column];
         std::shared_ptr<arrow::Array> array;
-        (void)builder->Finish(&array);
-        arrays.emplace_back(array);
+        std::visit(overloaded{[&](uint8_t) {
+                                  array = build_column<uint8_t, arrow::UInt8Builder>(column_cells,
+                                                                                     num_rows);
+                              },
+                              [&](uint16_t) {
+                                  array = build_column<uint16_t, arrow::UInt16Builder>(
+                                      column_cells, num_rows);
+                              },
+                              [&](uint32_t) {
+                                  array = build_column<uint32_t, arrow::UInt32Builder>(
+                                      column_cells, num_rows);
+                              },
+                              [&](uint64_t) {
+                                  array = build_column<uint64_t, arrow::UInt64Builder>(
+                                      column_cells, num_rows);
+                              },
+                              [&](bool) {
+                                  array = build_column<bool, arrow::BooleanBuilder>(column_cells,
+                                                                                    num_rows);
+                              },
+                              [&](const std::string &) {
+                                  array = build_column<std::string, arrow::StringBuilder>(
+                                      column_cells, num_rows);
+                              }},
+                   v);
+        arrays.emplace_back(std::move(array));
+    }
+}
+
+template <typename T>
+void serialize(const T *batch, std::vector<std::shared_ptr<arrow::Array>> &arrays) {
+    auto const &ref = (*batch)[0]->values();
+    auto const num_rows = batch->size();
+    auto const num_columns = ref.size();
+    if (num_columns == 0) return;
+
+    // gather pointers into a column-major staging area with a single pass over the value maps,
+    // so that each column can be appended in one tight loop afterwards
+    std::vector<const AttributeValue *> cells(num_rows * num_columns, nullptr);
+    for (uint64_t row = 0; row < num_rows; row++) {
+        auto const &values = (*batch)[row]->values();
+        // mismatched entries are serialized as null. both maps are sorted, so names and types
+        // can be compared in one pass
+        if (values.size() != num_columns) continue;
+        auto same = [](const auto &a, const auto &b) {
+            return a.first == b.first && a.second.index() == b.second.index();
+        };
+        if (!std::equal(values.begin(), values.end(), ref.begin(), same)) continue;
+        uint64_t column = 0;
+        for (auto const &iter : values) {
+            cells[column++ * num_rows + row] = &iter.second;
+        }
     }
+
+    // the schema is resolved once per column from the first entry
+    std::vector<const AttributeValue *> ref_values;
+    ref_values.reserve(num_columns);
+    for (auto const &iter : ref) ref_values.emplace_back(&iter.second);
+    build_columns(cells, num_rows, ref_values, arrays);
+}
+
+template <typename CType, typename BuilderType, typename F>
+std::shared_ptr<arrow::Array> build_fixed_column(const EventBatch *batch, const F &get_value) {
+    BuilderType builder(arrow::default_memory_pool());
+    if (!builder.Reserve(static_cast<int64_t>(batch->size())).ok()) return nullptr;
+    if constexpr (std::is_same_v<CType, std::string>) {
+        uint64_t data_size = 0;
+        for (auto const &event : *batch) data_size += get_value(*event).size();
+        if (!builder.ReserveData(static_cast<int64_t>(data_size)).ok()) return nullptr;
+    }
+    for (auto const &event : *batch) {
+        builder.UnsafeAppend(get_value(*event));
+    }
+    std::shared_ptr<arrow::Array> array;
+    if (!builder.Finish(&array).ok()) return nullptr;
+    return array;
 }
 
 void serialize(const EventBatch *batch, std::vector<std::shared_ptr<arrow::Field>> &fields,
                std::vector<std::shared_ptr<arrow::Array>> &arrays) {
-    get_schema(batch->front()->values(), fields);
-    serialize(batch, arrays);
+    auto const &ref = *batch->front();
+    auto const &schema = ref.schema();
+    auto const num_rows = batch->size();
+    auto const num_columns = schema.size();
+
+    // events with the same schema have their slots in the same order, so the cells can be
+    // gathered without any name lookup. mismatched entries are serialized as null
+    std::vector<const AttributeValue *> cells(num_rows * num_columns, nullptr);
+    for (uint64_t row = 0; row < num_rows; row++) {
+        auto const &event = *(*batch)[row];
+        if (event.schema_id() != schema.id()) continue;
+        auto const &slots = event.slots();
+        for (uint64_t column = 0; column < num_columns; column++) {
+            cells[column * num_rows + row] = &slots[column];
+        }
+    }
+
+    std::vector<std::shared_ptr<arrow::Field>> value_fields;
+    std::vector<std::shared_ptr<arrow::Array>> value_arrays;
+    std::vector<const AttributeValue *> ref_values;
+    ref_values.reserve(num_columns);
+    for (uint64_t column = 0; column < num_columns; column++) {
+        ref_values.emplace_back(&ref.slots()[column]);
+        value_fields.emplace_back(arrow::field(schema.name(column), get_type(ref.slots()[column])));
+    }
+    build_columns(cells, num_rows, ref_values, value_arrays);
+
+    // time, id and name are stored outside of the slots, so they are built directly
+    value_fields.emplace_back(arrow::field(Event::TIME_NAME, arrow::uint64()));
+    value_arrays.emplace_back(build_fixed_column<uint64_t, arrow::UInt64Builder>(
+        batch, [](const Event &e) { return e.time(); }));
+    value_fields.emplace_back(arrow::field(Event::ID_NAME, arrow::uint64()));
+    value_arrays.emplace_back(build_fixed_column<uint64_t, arrow::UInt64Builder>(
+        batch, [](const Event &e) { return e.id(); }));
+    value_fields.emplace_back(arrow::field(Event::NAME_NAME, arrow::utf8()));
+    value_arrays.emplace_back(build_fixed_column<std::string, arrow::StringBuilder>(
+        batch, [](const Event &e) -> auto const & { return e.name(); }));
+
+    // keep the columns sorted by name, same as the value map of transactions
+    std::vector<uint64_t> order(value_fields.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&value_fields](uint64_t a, uint64_t b) {
+        return value_fields[a]->name() < value_fields[b]->name();
+    });
+    fields.reserve(fields.size() + order.size());
+    arrays.reserve(arrays.size() + order.size());
+    for (auto i : order) {
+        fields.emplace_back(std::move(value_fields[i]));
+        arrays.emplace_back(std::move(value_arrays[i]));
+    }
 }
 
 void serialize(const TransactionBatch *batch, std::vector<std::shared_ptr<arrow::Field>> &fields,
@@ -169,69 +259,125 @@ std::shared_ptr<arrow::Table> deserialize(const std::shared_ptr<arrow::Buffer> &
     return *table;
 }
 
-template <typename T>
-bool deserialize_(T *batch, const arrow::Table *table,
-                 const std::unordered_set<std::string> &fields) {
-    if (fields.empty()) return true;
-
-    auto bool_ = arrow::boolean();
-    auto uint8 = arrow::uint8();
-    auto uint16 = arrow::uint16();
-    auto uint32 = arrow::uint32();
-    auto uint64 = arrow::uint64();
-    auto str_ = arrow::utf8();
+// index into AttributeValue for an arrow column type, -1 if it is not supported
+int get_value_type(arrow::Type::type type) {
+    switch (type) {
+        case arrow::Type::UINT64:
+            return static_cast<int>(AttributeValue(std::in_place_type<uint64_t>).index());
+        case arrow::Type::UINT32:
+            return static_cast<int>(AttributeValue(std::in_place_type<uint32_t>).index());
+        case arrow::Type::UINT16:
+            return static_cast<int>(AttributeValue(std::in_place_type<uint16_t>).index());
+        case arrow::Type::UINT8:
+            return static_cast<int>(AttributeValue(std::in_place_type<uint8_t>).index());
+        case arrow::Type::BOOL:
+            return static_cast<int>(AttributeValue(std::in_place_type<bool>).index());
+        case arrow::Type::STRING:
+            return static_cast<int>(AttributeValue(std::in_place_type<std::string>).index());
+        default:
+            return -1;
+    }
+}
 
-    auto const &schema = table->schema();
-    auto const &all_fields = schema->fields();
+template <typename ArrayType>
+auto get_value(const ArrayType *array, int64_t index) {
+    if constexpr (std::is_same_v<ArrayType, arrow::StringArray>) {
+        return array->GetString(index);
+    } else {
+        return array->Value(index);
+    }
+}
 
-    // look through each column and fill in data
+// calls func(name, offset, array) for every chunk of the selected columns. the column type is
+// resolved once per chunk and passed as the concrete array type
+template <typename F>
+void visit_columns(const arrow::Table *table, const std::unordered_set<std::string> &fields,
+                   F &&func) {
+    auto const &all_fields = table->schema()->fields();
     for (int i = 0; i < table->num_columns(); i++) {
         auto const &name = all_fields[i]->name();
         if (fields.find(name) == fields.end()) continue;
 
-        auto type = all_fields[i]->type();
         auto const &column_chunks = table->column(i);
+        uint64_t offset = 0;
         for (auto chunk_idx = 0; chunk_idx < column_chunks->num_chunks(); chunk_idx++) {
-            auto const &column = column_chunks->chunk(chunk_idx);
-            for (int j = 0; j < column->length(); j++) {
-                auto r_ = column->GetScalar(j);
-                if (!r_.ok()) return false;
-                auto const &v = *r_;
-                if (type->Equals(str_)) {
-                    (*batch)[j]->add_value(name, get_string(v));
-                } else if (type->Equals(uint8)) {
-                    (*batch)[j]->add_value(name, get_uint8(v));
-                } else if (type->Equals(uint16)) {
-                    auto int_val_ = std::reinterpret_pointer_cast<arrow::UInt16Scalar>(v);
-                    (*batch)[j]->add_value(name, get_uint16(v));
-                } else if (type->Equals(uint32)) {
-                    auto int_val_ = std::reinterpret_pointer_cast<arrow::UInt32Scalar>(v);
-                    (*batch)[j]->add_value(name, get_uint32(v));
-                } else if (type->Equals(uint64)) {
-                    auto int_val = get_uint64(v);
-                    (*batch)[j]->add_value(name, int_val);
-                } else if (type->Equals(bool_)) {
-                    auto bool_val_ = std::reinterpret_pointer_cast<arrow::BooleanScalar>(v);
-                    (*batch)[j]->add_value(name, get_bool(v));
-                } else {
-                    auto error_msg =
-                        fmt::format("Unknown type {0} for column {1}", type->ToString(), name);
+            auto const *column = column_chunks->chunk(chunk_idx).get();
+            switch (column->type_id()) {
+                case arrow::Type::UINT8:
+                    func(name, offset, static_cast<const arrow::UInt8Array *>(column));
+                    break;
+                case arrow::Type::UINT16:
+                    func(name, offset, static_cast<const arrow::UInt16Array *>(column));
+                    break;
+                case arrow::Type::UINT32:
+                    func(name, offset, static_cast<const arrow::UInt32Array *>(column));
+                    break;
+                case arrow::Type::UINT64:
+                    func(name, offset, static_cast<const arrow::UInt64Array *>(column));
+                    break;
+                case arrow::Type::BOOL:
+                    func(name, offset, static_cast<const arrow::BooleanArray *>(column));
+                    break;
+                case arrow::Type::STRING:
+                    func(name, offset, static_cast<const arrow::StringArray *>(column));
+                    break;
+                default: {
+                    auto error_msg = fmt::format("Unknown type {0} for column {1}",
+                                                 column->type()->ToString(), name);
                     throw std::runtime_error(error_msg);
                 }
             }
+            offset += column->length();
         }
     }
-    return true;
 }
 
 bool deserialize(EventBatch *batch, const arrow::Table *table,
                  const std::unordered_set<std::string> &fields) {
-    return deserialize_(batch, table, fields);
+    if (fields.empty()) return true;
+
+    // all the rows share one schema, so each column is resolved to its slot once and the
+    // values are written in place
+    SchemaRegistry::Fields schema_fields;
+    for (auto const &field : table->schema()->fields()) {
+        auto const &name = field->name();
+        if (Event::is_fixed_value(name) || fields.find(name) == fields.end()) continue;
+        // unsupported columns are reported below
+        auto type = get_value_type(field->type()->id());
+        if (type >= 0) schema_fields.emplace_back(name, type);
+    }
+    auto const *schema = SchemaRegistry::global().get(std::move(schema_fields));
+    for (auto &event : *batch) event->set_schema(schema);
+
+    visit_columns(table, fields, [batch, schema](const std::string &name, uint64_t offset,
+                                                 const auto *array) {
+        auto const length = array->length();
+        if (Event::is_fixed_value(name)) {
+            for (int64_t j = 0; j < length; j++) {
+                (*batch)[offset + j]->add_value(name, get_value(array, j));
+            }
+            return;
+        }
+        auto index = schema->find(name);
+        for (int64_t j = 0; j < length; j++) {
+            (*batch)[offset + j]->set_slot(index, get_value(array, j));
+        }
+    });
+    return true;
 }
 
 bool deserialize(TransactionBatch *batch, const arrow::Table *table,
                  const std::unordered_set<std::string> &fields) {
-    return deserialize_(batch, table, fields);
+    if (fields.empty()) return true;
+
+    visit_columns(table, fields, [batch](const std::string &name, uint64_t offset,
+                                         const auto *array) {
+        auto const length = array->length();
+        for (int64_t j = 0; j < length; j++) {
+            (*batch)[offset + j]->add_value(name, get_value(array, j));
+        }
+    });
+    return true;
 }
 
 std::shared_ptr<arrow::Table> load_table(const std::string &filename) {
@@ -300,26 +446,89 @@ bool get_bool(const std::shared_ptr<arrow::Scalar> &scalar) {
 
 std::vector<uint64_t> get_uint64s(const std::shared_ptr<arrow::Scalar> &scalar) {
     auto list_scalar = std::reinterpret_pointer_cast<arrow::ListScalar>(scalar);
-    auto size = list_scalar->value->length();
-    std::vector<uint64_t> result(size);
-    for (int64_t j = 0; j < size; j++) {
-        auto v = get_uint64(*list_scalar->value->GetScalar(j));
-        result[j] = v;
-    }
+    std::vector<uint64_t> result;
+    decode_uint64s(list_scalar->value.get(), result);
     return result;
 }
 
 std::vector<bool> get_bools(const std::shared_ptr<arrow::Scalar> &scalar) {
     auto list_scalar = std::reinterpret_pointer_cast<arrow::ListScalar>(scalar);
-    auto size = list_scalar->value->length();
-    std::vector<bool> result(size);
-    for (int64_t j = 0; j < size; j++) {
-        auto v = get_bool(*list_scalar->value->GetScalar(j));
-        result[j] = v;
-    }
+    std::vector<bool> result;
+    decode_bools(list_scalar->value.get(), result);
     return result;
 }
 
+bool decode_uint64s(const arrow::Array *array, std::vector<uint64_t> &values) {
+    if (array->type_id() != arrow::Type::UINT64) return false;
+    auto const *raw = static_cast<const arrow::UInt64Array *>(array)->raw_values();
+    values.assign(raw, raw + array->length());
+    return true;
+}
+
+bool decode_bools(const arrow::Array *array, std::vector<bool> &values) {
+    if (array->type_id() != arrow::Type::BOOL) return false;
+    auto const *bools = static_cast<const arrow::BooleanArray *>(array);
+    auto const length = bools->length();
+    values.resize(length);
+    for (int64_t i = 0; i < length; i++) {
+        values[i] = bools->Value(i);
+    }
+    return true;
+}
+
+bool decode_strings(const arrow::Array *array, std::vector<std::string> &values) {
+    if (array->type_id() != arrow::Type::STRING) return false;
+    auto const *strings = static_cast<const arrow::StringArray *>(array);
+    auto const length = strings->length();
+    values.resize(length);
+    for (int64_t i = 0; i < length; i++) {
+        auto view = strings->GetView(i);
+        values[i].assign(view.data(), view.size());
+    }
+    return true;
+}
+
+// returns the flat value array if the list has the expected value type
+const arrow::Array *get_list_values(const arrow::Array *array, arrow::Type::type type) {
+    if (array->type_id() != arrow::Type::LIST) return nullptr;
+    auto const *list = static_cast<const arrow::ListArray *>(array);
+    if (list->value_type()->id() != type) return nullptr;
+    return list->values().get();
+}
+
+bool decode_uint64_lists(const arrow::Array *array, std::vector<std::vector<uint64_t>> &values) {
+    auto const *flat = get_list_values(array, arrow::Type::UINT64);
+    if (!flat) return false;
+    auto const *list = static_cast<const arrow::ListArray *>(array);
+    auto const *raw = static_cast<const arrow::UInt64Array *>(flat)->raw_values();
+    auto const length = list->length();
+    values.resize(length);
+    for (int64_t i = 0; i < length; i++) {
+        auto const begin = list->value_offset(i);
+        values[i].assign(raw + begin, raw + begin + list->value_length(i));
+    }
+    return true;
+}
+
+bool decode_bool_lists(const arrow::Array *array, std::vector<std::vector<bool>> &values) {
+    auto const *flat = get_list_values(array, arrow::Type::BOOL);
+    if (!flat) return false;
+    auto const *list = static_cast<const arrow::ListArray *>(array);
+    auto const *bools = static_cast<const arrow::BooleanArray *>(flat);
+    auto const length = list->length();
+    values.resize(length);
+    for (int64_t i = 0; i < length; i++) {
+        auto const begin = list->value_offset(i);
+        auto const size = list->value_length(i);
+        auto &row = values[i];
+        row.resize(size);
+        for (int64_t j = 0; j < size; j++) {
+            row[j] = bools->Value(begin + j);
+        }
+    }
+    return true;
+}
+
 FileSystemInfo::FileSystemInfo(const std::string &path) {
     if (path.find("://") == std::string::npos) {
         this->path = std::filesystem::absolute(path);
@@ -378,4 +587,16 @@ std::shared_ptr<arrow::fs::FileSystem> load_fs(const FileSystemInfo &info) {
     return result;
 }
 
+std::optional<std::string> read_file(const std::shared_ptr<arrow::fs::FileSystem> &fs,
+                                     const std::string &filename) {
+    auto file_res = fs->OpenInputFile(filename);
+    if (!file_res.ok()) return std::nullopt;
+    auto file = *file_res;
+    auto size_res = file->GetSize();
+    if (!size_res.ok()) return std::nullopt;
+    auto buffer_res = file->Read(*size_res);
+    if (!buffer_res.ok()) return std::nullopt;
+    return (*buffer_res)->ToString();
+}
+
 }  // namespace hermes
\ No newline at end of file
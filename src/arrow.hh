@@ -3,8 +3,10 @@
 
 #include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 namespace arrow {
 class Buffer;
@@ -57,6 +59,14 @@ bool get_bool(const std::shared_ptr<arrow::Scalar> &scalar);
 std::vector<uint64_t> get_uint64s(const std::shared_ptr<arrow::Scalar> &scalar);
 std::vector<bool> get_bools(const std::shared_ptr<arrow::Scalar> &scalar);
 
+// bulk column decoders. the array type is checked once and values are read directly from the
+// value and offset buffers. return false if the array type does not match
+bool decode_uint64s(const arrow::Array *array, std::vector<uint64_t> &values);
+bool decode_bools(const arrow::Array *array, std::vector<bool> &values);
+bool decode_strings(const arrow::Array *array, std::vector<std::string> &values);
+bool decode_uint64_lists(const arrow::Array *array, std::vector<std::vector<uint64_t>> &values);
+bool decode_bool_lists(const arrow::Array *array, std::vector<std::vector<bool>> &values);
+
 struct FileSystemInfo {
 public:
     explicit FileSystemInfo(const std::string &path);
@@ -74,6 +84,9 @@ private:
 };
 
 std::shared_ptr<arrow::fs::FileSystem> load_fs(const FileSystemInfo &info);
+// read the entire file into a string. nullopt if the file cannot be read
+std::optional<std::string> read_file(const std::shared_ptr<arrow::fs::FileSystem> &fs,
+                                     const std::string &filename);
 
 }  // namespace hermes
 
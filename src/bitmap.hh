@@ -0,0 +1,474 @@
+#ifndef HERMES_BITMAP_HH
+#define HERMES_BITMAP_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace hermes {
+
+// compressed set of row indices, similar to a roaring bitmap. values are split into chunks of
+// 2^16 by their upper bits. each chunk is stored as a sorted array when it is sparse, as a bitset
+// when it is dense, or as a list of runs when the values are mostly consecutive, so the memory
+// usage follows the structure of the selection instead of its size
+class RowBitmap {
+private:
+    enum class Kind : uint8_t { array, bitset, run };
+    struct Run {
+        uint16_t start;
+        // inclusive
+        uint16_t last;
+    };
+    struct Container {
+        explicit Container(uint64_t key = 0) : key(key) {}
+        uint64_t key;
+        Kind kind = Kind::array;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> values;
+        std::vector<uint64_t> words;
+        std::vector<Run> runs;
+    };
+
+    static constexpr uint64_t chunk_bits = 16;
+    static constexpr uint64_t num_words = (1u << chunk_bits) / 64;
+    // beyond this an array takes more space than a bitset
+    static constexpr uint64_t max_array_size = 4096;
+
+public:
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = uint64_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const uint64_t *;
+        using reference = const uint64_t &;
+
+        iterator() = default;
+
+        uint64_t operator*() const { return value_; }
+        iterator &operator++() {
+            auto const &c = bitmap_->containers_[container_];
+            switch (c.kind) {
+                case Kind::array:
+                    pos_++;
+                    break;
+                case Kind::bitset:
+                    // clear the lowest bit
+                    state_ &= state_ - 1;
+                    break;
+                case Kind::run:
+                    if (c.runs[pos_].start + state_ < c.runs[pos_].last) {
+                        state_++;
+                    } else {
+                        pos_++;
+                        state_ = 0;
+                    }
+                    break;
+            }
+            seek();
+            return *this;
+        }
+
+        friend bool operator==(const iterator &a, const iterator &b) {
+            return a.container_ == b.container_ && a.value_ == b.value_;
+        }
+        friend bool operator!=(const iterator &a, const iterator &b) { return !(a == b); }
+
+    private:
+        const RowBitmap *bitmap_ = nullptr;
+        uint64_t container_ = 0;
+        // array index, word index or run index
+        uint64_t pos_ = 0;
+        // remaining bits of the current word, or the offset inside the current run
+        uint64_t state_ = 0;
+        uint64_t value_ = 0;
+
+        iterator(const RowBitmap *bitmap, uint64_t container) : bitmap_(bitmap) {
+            start(container);
+        }
+
+        void start(uint64_t container) {
+            container_ = container;
+            pos_ = 0;
+            state_ = 0;
+            value_ = 0;
+            if (container_ >= bitmap_->containers_.size()) return;
+            auto const &c = bitmap_->containers_[container_];
+            if (c.kind == Kind::bitset) state_ = c.words[0];
+        }
+
+        // moves to the first value at or after the current position
+        void seek() {
+            while (container_ < bitmap_->containers_.size()) {
+                auto const &c = bitmap_->containers_[container_];
+                auto base = c.key << chunk_bits;
+                switch (c.kind) {
+                    case Kind::array:
+                        if (pos_ < c.values.size()) {
+                            value_ = base | c.values[pos_];
+                            return;
+                        }
+                        break;
+                    case Kind::bitset:
+                        // zero words are skipped as a whole
+                        while (state_ == 0 && ++pos_ < num_words) state_ = c.words[pos_];
+                        if (state_ != 0) {
+                            value_ = base | (pos_ * 64 + __builtin_ctzll(state_));
+                            return;
+                        }
+                        break;
+                    case Kind::run:
+                        if (pos_ < c.runs.size()) {
+                            value_ = base | (c.runs[pos_].start + state_);
+                            return;
+                        }
+                        break;
+                }
+                start(container_ + 1);
+            }
+        }
+
+        friend class RowBitmap;
+    };
+
+    RowBitmap() = default;
+
+    // every value in [begin, end)
+    static RowBitmap range(uint64_t begin, uint64_t end) {
+        RowBitmap result;
+        while (begin < end) {
+            Container c;
+            c.key = begin >> chunk_bits;
+            auto chunk_end = std::min(end, (c.key + 1) << chunk_bits);
+            c.kind = Kind::run;
+            c.runs.emplace_back(Run{low_bits(begin), low_bits(chunk_end - 1)});
+            c.cardinality = chunk_end - begin;
+            result.containers_.emplace_back(std::move(c));
+            begin = chunk_end;
+        }
+        result.update_offsets();
+        return result;
+    }
+
+    // fastest when the values are added in increasing order
+    void add(uint64_t value) {
+        auto key = value >> chunk_bits;
+        uint64_t index;
+        if (containers_.empty() || containers_.back().key < key) {
+            index = containers_.size();
+            containers_.emplace_back(Container{key});
+            offsets_.emplace_back(offsets_.back());
+        } else {
+            auto it = std::lower_bound(
+                containers_.begin(), containers_.end(), key,
+                [](const Container &c, uint64_t k) { return c.key < k; });
+            index = static_cast<uint64_t>(std::distance(containers_.begin(), it));
+            if (it->key != key) {
+                containers_.insert(it, Container{key});
+                offsets_.insert(offsets_.begin() + index + 1, offsets_[index]);
+            }
+        }
+        if (add(containers_[index], low_bits(value))) {
+            for (auto i = index + 1; i < offsets_.size(); i++) offsets_[i]++;
+        }
+    }
+
+    [[nodiscard]] bool contains(uint64_t value) const {
+        auto key = value >> chunk_bits;
+        auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+                                   [](const Container &c, uint64_t k) { return c.key < k; });
+        if (it == containers_.end() || it->key != key) return false;
+        auto low = low_bits(value);
+        switch (it->kind) {
+            case Kind::array:
+                return std::binary_search(it->values.begin(), it->values.end(), low);
+            case Kind::bitset:
+                return (it->words[low / 64] >> (low % 64u)) & 1u;
+            case Kind::run: {
+                auto run = std::upper_bound(it->runs.begin(), it->runs.end(), low,
+                                            [](uint16_t v, const Run &r) { return v < r.start; });
+                return run != it->runs.begin() && low <= std::prev(run)->last;
+            }
+        }
+        return false;
+    }
+
+    [[nodiscard]] uint64_t size() const { return offsets_.back(); }
+    [[nodiscard]] bool empty() const { return size() == 0; }
+
+    [[nodiscard]] iterator begin() const {
+        iterator it(this, 0);
+        it.seek();
+        return it;
+    }
+    [[nodiscard]] iterator end() const { return iterator(this, containers_.size()); }
+
+    // iterator to the rank-th smallest value. O(log containers) plus a scan inside the container
+    [[nodiscard]] iterator at(uint64_t rank) const {
+        if (rank >= size()) return end();
+        auto it = std::upper_bound(offsets_.begin(), offsets_.end(), rank);
+        auto index = static_cast<uint64_t>(std::distance(offsets_.begin(), it)) - 1;
+        rank -= offsets_[index];
+        iterator result(this, index);
+        auto const &c = containers_[index];
+        switch (c.kind) {
+            case Kind::array:
+                result.pos_ = rank;
+                break;
+            case Kind::bitset: {
+                uint64_t word = 0;
+                auto count = static_cast<uint64_t>(__builtin_popcountll(c.words[word]));
+                while (rank >= count) {
+                    rank -= count;
+                    count = static_cast<uint64_t>(__builtin_popcountll(c.words[++word]));
+                }
+                auto bits = c.words[word];
+                for (uint64_t i = 0; i < rank; i++) bits &= bits - 1;
+                result.pos_ = word;
+                result.state_ = bits;
+                break;
+            }
+            case Kind::run: {
+                uint64_t run = 0;
+                while (rank > static_cast<uint64_t>(c.runs[run].last - c.runs[run].start)) {
+                    rank -= c.runs[run].last - c.runs[run].start + 1;
+                    run++;
+                }
+                result.pos_ = run;
+                result.state_ = rank;
+                break;
+            }
+        }
+        result.seek();
+        return result;
+    }
+    [[nodiscard]] uint64_t select(uint64_t rank) const { return *at(rank); }
+
+    // converts every container into its smallest representation
+    void optimize() {
+        for (auto &c : containers_) {
+            uint64_t num_runs = count_runs(c);
+            auto run_size = num_runs * sizeof(Run);
+            auto array_size = c.cardinality * sizeof(uint16_t);
+            auto bitset_size = num_words * sizeof(uint64_t);
+            if (run_size < std::min(array_size, bitset_size)) {
+                convert(c, Kind::run);
+            } else if (c.cardinality <= max_array_size) {
+                convert(c, Kind::array);
+            } else {
+                convert(c, Kind::bitset);
+            }
+        }
+    }
+
+    [[nodiscard]] uint64_t memory_size() const {
+        uint64_t result = sizeof(RowBitmap) + containers_.capacity() * sizeof(Container) +
+                          offsets_.capacity() * sizeof(uint64_t);
+        for (auto const &c : containers_) {
+            result += c.values.capacity() * sizeof(uint16_t) +
+                      c.words.capacity() * sizeof(uint64_t) + c.runs.capacity() * sizeof(Run);
+        }
+        return result;
+    }
+
+    friend RowBitmap operator&(const RowBitmap &a, const RowBitmap &b) {
+        RowBitmap result;
+        auto it_a = a.containers_.begin();
+        auto it_b = b.containers_.begin();
+        while (it_a != a.containers_.end() && it_b != b.containers_.end()) {
+            if (it_a->key < it_b->key) {
+                it_a++;
+            } else if (it_b->key < it_a->key) {
+                it_b++;
+            } else {
+                Container c;
+                if (it_a->kind == Kind::array && it_b->kind == Kind::array) {
+                    c.key = it_a->key;
+                    std::set_intersection(it_a->values.begin(), it_a->values.end(),
+                                          it_b->values.begin(), it_b->values.end(),
+                                          std::back_inserter(c.values));
+                    c.cardinality = c.values.size();
+                } else {
+                    auto words = to_words(*it_a);
+                    auto other = to_words(*it_b);
+                    for (uint64_t i = 0; i < num_words; i++) words[i] &= other[i];
+                    c = from_words(it_a->key, words);
+                }
+                if (c.cardinality > 0) result.containers_.emplace_back(std::move(c));
+                it_a++;
+                it_b++;
+            }
+        }
+        result.update_offsets();
+        result.optimize();
+        return result;
+    }
+
+    friend RowBitmap operator|(const RowBitmap &a, const RowBitmap &b) {
+        RowBitmap result;
+        auto it_a = a.containers_.begin();
+        auto it_b = b.containers_.begin();
+        while (it_a != a.containers_.end() || it_b != b.containers_.end()) {
+            if (it_b == b.containers_.end() ||
+                (it_a != a.containers_.end() && it_a->key < it_b->key)) {
+                result.containers_.emplace_back(*it_a++);
+            } else if (it_a == a.containers_.end() || it_b->key < it_a->key) {
+                result.containers_.emplace_back(*it_b++);
+            } else {
+                Container c;
+                if (it_a->kind == Kind::array && it_b->kind == Kind::array &&
+                    it_a->cardinality + it_b->cardinality <= max_array_size) {
+                    c.key = it_a->key;
+                    std::set_union(it_a->values.begin(), it_a->values.end(),
+                                   it_b->values.begin(), it_b->values.end(),
+                                   std::back_inserter(c.values));
+                    c.cardinality = c.values.size();
+                } else {
+                    auto words = to_words(*it_a);
+                    auto other = to_words(*it_b);
+                    for (uint64_t i = 0; i < num_words; i++) words[i] |= other[i];
+                    c = from_words(it_a->key, words);
+                }
+                result.containers_.emplace_back(std::move(c));
+                it_a++;
+                it_b++;
+            }
+        }
+        result.update_offsets();
+        result.optimize();
+        return result;
+    }
+
+private:
+    // sorted by key
+    std::vector<Container> containers_;
+    // number of values before each container, plus the total at the end
+    std::vector<uint64_t> offsets_ = {0};
+
+    static uint16_t low_bits(uint64_t value) { return static_cast<uint16_t>(value); }
+
+    void update_offsets() {
+        offsets_.resize(containers_.size() + 1);
+        for (uint64_t i = 0; i < containers_.size(); i++) {
+            offsets_[i + 1] = offsets_[i] + containers_[i].cardinality;
+        }
+    }
+
+    // returns true if the value is new
+    static bool add(Container &c, uint16_t low) {
+        if (c.kind == Kind::run) {
+            convert(c, c.cardinality < max_array_size ? Kind::array : Kind::bitset);
+        }
+        if (c.kind == Kind::array) {
+            if (c.values.empty() || c.values.back() < low) {
+                c.values.emplace_back(low);
+            } else {
+                auto it = std::lower_bound(c.values.begin(), c.values.end(), low);
+                if (*it == low) return false;
+                c.values.insert(it, low);
+            }
+            c.cardinality++;
+            if (c.cardinality > max_array_size) convert(c, Kind::bitset);
+            return true;
+        }
+        auto &word = c.words[low / 64];
+        auto mask = 1ull << (low % 64u);
+        if (word & mask) return false;
+        word |= mask;
+        c.cardinality++;
+        return true;
+    }
+
+    static uint64_t count_runs(const Container &c) {
+        switch (c.kind) {
+            case Kind::array: {
+                uint64_t result = 0;
+                for (uint64_t i = 0; i < c.values.size(); i++) {
+                    if (i == 0 || c.values[i] != c.values[i - 1] + 1) result++;
+                }
+                return result;
+            }
+            case Kind::bitset: {
+                // a run starts at every set bit whose predecessor is not set
+                uint64_t result = 0;
+                uint64_t carry = 0;
+                for (auto word : c.words) {
+                    result += __builtin_popcountll(word & ~((word << 1u) | carry));
+                    carry = word >> 63u;
+                }
+                return result;
+            }
+            case Kind::run:
+                return c.runs.size();
+        }
+        return 0;
+    }
+
+    static std::vector<uint64_t> to_words(const Container &c) {
+        if (c.kind == Kind::bitset) return c.words;
+        std::vector<uint64_t> words(num_words, 0);
+        auto set = [&words](uint64_t v) { words[v / 64] |= 1ull << (v % 64u); };
+        if (c.kind == Kind::array) {
+            for (auto v : c.values) set(v);
+        } else {
+            for (auto const &run : c.runs) {
+                for (uint64_t v = run.start; v <= run.last; v++) set(v);
+            }
+        }
+        return words;
+    }
+
+    static Container from_words(uint64_t key, std::vector<uint64_t> words) {
+        Container c;
+        c.key = key;
+        c.kind = Kind::bitset;
+        for (auto word : words) c.cardinality += __builtin_popcountll(word);
+        c.words = std::move(words);
+        if (c.cardinality <= max_array_size) convert(c, Kind::array);
+        return c;
+    }
+
+    static void convert(Container &c, Kind kind) {
+        if (c.kind == kind) return;
+        auto words = to_words(c);
+        c.values.clear();
+        c.values.shrink_to_fit();
+        c.words.clear();
+        c.words.shrink_to_fit();
+        c.runs.clear();
+        c.runs.shrink_to_fit();
+        c.kind = kind;
+        switch (kind) {
+            case Kind::array: {
+                c.values.reserve(c.cardinality);
+                for (uint64_t i = 0; i < num_words; i++) {
+                    for (auto bits = words[i]; bits; bits &= bits - 1) {
+                        c.values.emplace_back(i * 64 + __builtin_ctzll(bits));
+                    }
+                }
+                break;
+            }
+            case Kind::bitset:
+                c.words = std::move(words);
+                break;
+            case Kind::run: {
+                for (uint64_t i = 0; i < num_words; i++) {
+                    for (auto bits = words[i]; bits; bits &= bits - 1) {
+                        auto v = static_cast<uint16_t>(i * 64 + __builtin_ctzll(bits));
+                        if (!c.runs.empty() && c.runs.back().last + 1 == v) {
+                            c.runs.back().last = v;
+                        } else {
+                            c.runs.emplace_back(Run{v, v});
+                        }
+                    }
+                }
+                break;
+            }
+        }
+    }
+};
+
+}  // namespace hermes
+
+#endif  // HERMES_BITMAP_HH
@@ -1,9 +1,19 @@
 #ifndef HERMES_CACHE_HH
 #define HERMES_CACHE_HH
 
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <iterator>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace hermes {
 // implementation is based on
@@ -56,6 +66,440 @@ private:
     size_t max_size_;
 };
 
+// replacement policy of a sharded cache
+//   lru: evicts the least recently used entry
+//   two_queue: 2Q variant. new entries go to a small fifo probation queue and are only moved
+//              to the main lru list once they are accessed again, or if they come back shortly
+//              after being evicted from probation. entries that are only touched once, e.g. by
+//              a range query over the whole trace, can't flush the working set
+enum class CachePolicy { lru, two_queue };
+
+// how the caller is going to use the entry
+//   normal: regular access
+//   scan: sequential pass that will not come back. hits do not refresh the entry and new
+//         entries are evicted before anything else
+enum class CacheHint { normal, scan };
+
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    // misses that waited for another thread to load the same key
+    uint64_t coalesced = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+    // bytes held by entries that are still in probation
+    uint64_t probation_bytes = 0;
+};
+
+// <tier, access time>. entries with the lowest rank are evicted first
+using EvictionRank = std::pair<uint64_t, uint64_t>;
+
+class Evictable {
+public:
+    // rank of the entry that would be evicted next. nullopt if empty
+    [[nodiscard]] virtual std::optional<EvictionRank> victim_rank() const = 0;
+    // evicts the next victim. returns false if there is nothing to evict
+    virtual bool evict_one() = 0;
+    virtual ~Evictable() = default;
+};
+
+// memory budget shared by several caches. all the caches use the same logical clock, so once
+// the budget is exceeded the victim with the lowest rank across all the caches is evicted
+class MemoryBudget {
+public:
+    explicit MemoryBudget(uint64_t capacity) : capacity_(capacity) {}
+
+    [[nodiscard]] uint64_t capacity() const { return capacity_; }
+    [[nodiscard]] uint64_t usage() const { return usage_; }
+    void set_capacity(uint64_t capacity) {
+        capacity_ = capacity;
+        shrink();
+    }
+
+    void charge(uint64_t bytes) {
+        usage_ += bytes;
+        if (usage_ > capacity_) shrink();
+    }
+    void release(uint64_t bytes) { usage_ -= bytes; }
+    uint64_t tick() { return clock_++; }
+
+    void add(Evictable *cache) {
+        std::lock_guard guard(mutex_);
+        caches_.emplace_back(cache);
+    }
+    void remove(Evictable *cache) {
+        std::lock_guard guard(mutex_);
+        caches_.erase(std::remove(caches_.begin(), caches_.end(), cache), caches_.end());
+    }
+
+private:
+    std::atomic<uint64_t> capacity_;
+    std::atomic<uint64_t> usage_ = 0;
+    std::atomic<uint64_t> clock_ = 0;
+    // protects caches_ and only lets one thread evict at a time
+    std::mutex mutex_;
+    std::vector<Evictable *> caches_;
+
+    void shrink() {
+        std::lock_guard guard(mutex_);
+        while (usage_ > capacity_) {
+            Evictable *target = nullptr;
+            std::optional<EvictionRank> target_rank;
+            for (auto *cache : caches_) {
+                auto rank = cache->victim_rank();
+                if (rank && (!target_rank || *rank < *target_rank)) {
+                    target = cache;
+                    target_rank = rank;
+                }
+            }
+            // everything is gone already
+            if (!target || !target->evict_one()) break;
+        }
+    }
+};
+
+// thread-safe cache that evicts by the size of the entries instead of the number of entries.
+// keys are spread over independently locked shards. each shard has a probation queue and a
+// main lru list, see CachePolicy
+template <typename key_t, typename value_t, typename hash_t = std::hash<key_t>>
+class ShardedCache : public Evictable {
+public:
+    static constexpr uint64_t default_num_shards = 16;
+    // share of the shard probation can hold under 2Q before it is evicted first
+    static constexpr uint64_t probation_percent = 25;
+    // value and its size in bytes, returned by the load function of get_or_load
+    using LoadResult = std::optional<std::pair<value_t, uint64_t>>;
+
+    explicit ShardedCache(std::shared_ptr<MemoryBudget> budget,
+                          uint64_t num_shards = default_num_shards,
+                          CachePolicy policy = CachePolicy::lru)
+        : budget_(std::move(budget)), shards_(std::max<uint64_t>(num_shards, 1)), policy_(policy) {
+        budget_->add(this);
+    }
+
+    ShardedCache(const ShardedCache &) = delete;
+    ShardedCache &operator=(const ShardedCache &) = delete;
+
+    ~ShardedCache() override {
+        budget_->remove(this);
+        clear();
+    }
+
+    [[nodiscard]] CachePolicy policy() const { return policy_; }
+    // only affects entries inserted afterwards
+    void set_policy(CachePolicy policy) { policy_ = policy; }
+
+    std::optional<value_t> get(const key_t &key, CacheHint hint = CacheHint::normal) {
+        auto &shard = get_shard(key);
+        std::lock_guard guard(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            misses_++;
+            return std::nullopt;
+        }
+        hits_++;
+        touch(shard, it->second, hint);
+        return it->second->value;
+    }
+
+    // returns the cached value, or calls load to produce it. concurrent misses on the same key
+    // only call load once and the other threads wait for its result. load returns the value
+    // and its size in bytes, or nullopt if nothing should be cached
+    template <typename F>
+    std::optional<value_t> get_or_load(const key_t &key, F &&load,
+                                       CacheHint hint = CacheHint::normal) {
+        auto &shard = get_shard(key);
+        std::promise<std::optional<value_t>> promise;
+        std::shared_future<std::optional<value_t>> future;
+        {
+            std::lock_guard guard(shard.mutex);
+            auto it = shard.map.find(key);
+            if (it != shard.map.end()) {
+                hits_++;
+                touch(shard, it->second, hint);
+                return it->second->value;
+            }
+            misses_++;
+            auto loading = shard.loading.find(key);
+            if (loading != shard.loading.end()) {
+                coalesced_++;
+                future = loading->second;
+            } else {
+                shard.loading.emplace(key, promise.get_future().share());
+            }
+        }
+        // someone else is loading the same key
+        if (future.valid()) return future.get();
+
+        LoadResult result;
+        try {
+            result = load();
+        } catch (...) {
+            {
+                std::lock_guard guard(shard.mutex);
+                shard.loading.erase(key);
+            }
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+        if (result) {
+            put(key, result->first, result->second, hint, true);
+        } else {
+            std::lock_guard guard(shard.mutex);
+            shard.loading.erase(key);
+        }
+        std::optional<value_t> value;
+        if (result) value = std::move(result->first);
+        promise.set_value(value);
+        return value;
+    }
+
+    void put(const key_t &key, const value_t &value, uint64_t size,
+             CacheHint hint = CacheHint::normal) {
+        put(key, value, size, hint, false);
+    }
+
+    bool exists(const key_t &key) const {
+        auto const &shard = get_shard(key);
+        std::lock_guard guard(shard.mutex);
+        return shard.map.find(key) != shard.map.end();
+    }
+
+    [[nodiscard]] std::optional<EvictionRank> victim_rank() const override {
+        std::optional<EvictionRank> result;
+        for (auto const &shard : shards_) {
+            std::lock_guard guard(shard.mutex);
+            auto rank = get_victim_rank(shard);
+            if (rank && (!result || *rank < *result)) result = rank;
+        }
+        return result;
+    }
+
+    bool evict_one() override {
+        // the victim of each shard is at one of its tails
+        while (true) {
+            Shard *target = nullptr;
+            std::optional<EvictionRank> target_rank;
+            for (auto &shard : shards_) {
+                std::lock_guard guard(shard.mutex);
+                auto rank = get_victim_rank(shard);
+                if (rank && (!target_rank || *rank < *target_rank)) {
+                    target = &shard;
+                    target_rank = rank;
+                }
+            }
+            if (!target) return false;
+
+            uint64_t size;
+            {
+                std::lock_guard guard(target->mutex);
+                // another thread touched the shard in the meantime
+                if (target->map.empty()) continue;
+                size = evict(*target);
+            }
+            evictions_++;
+            budget_->release(size);
+            return true;
+        }
+    }
+
+    void clear() {
+        for (auto &shard : shards_) {
+            uint64_t size;
+            {
+                std::lock_guard guard(shard.mutex);
+                size = shard.bytes;
+                shard.main.clear();
+                shard.probation.clear();
+                shard.map.clear();
+                shard.ghost.clear();
+                shard.ghost_map.clear();
+                shard.bytes = 0;
+                shard.probation_bytes = 0;
+            }
+            budget_->release(size);
+        }
+    }
+
+    [[nodiscard]] uint64_t size() const {
+        uint64_t result = 0;
+        for (auto const &shard : shards_) {
+            std::lock_guard guard(shard.mutex);
+            result += shard.map.size();
+        }
+        return result;
+    }
+
+    [[nodiscard]] CacheStats stats() const {
+        CacheStats result;
+        result.hits = hits_;
+        result.misses = misses_;
+        result.evictions = evictions_;
+        result.coalesced = coalesced_;
+        for (auto const &shard : shards_) {
+            std::lock_guard guard(shard.mutex);
+            result.entries += shard.map.size();
+            result.bytes += shard.bytes;
+            result.probation_bytes += shard.probation_bytes;
+        }
+        return result;
+    }
+
+    [[nodiscard]] const std::shared_ptr<MemoryBudget> &budget() const { return budget_; }
+
+private:
+    struct Entry {
+        key_t key;
+        value_t value;
+        uint64_t size;
+        // last access time from the budget clock
+        uint64_t time;
+        bool probation;
+        // inserted by a scan. these are not remembered after eviction
+        bool scan;
+    };
+    using EntryList = std::list<Entry>;
+    struct Shard {
+        mutable std::mutex mutex;
+        // both lists have the most recent entry at the front
+        EntryList main;
+        EntryList probation;
+        std::unordered_map<key_t, typename EntryList::iterator, hash_t> map;
+        // keys recently evicted from probation, most recent at the front
+        std::list<key_t> ghost;
+        std::unordered_map<key_t, typename std::list<key_t>::iterator, hash_t> ghost_map;
+        // keys that are currently being loaded by get_or_load
+        std::unordered_map<key_t, std::shared_future<std::optional<value_t>>, hash_t> loading;
+        uint64_t bytes = 0;
+        uint64_t probation_bytes = 0;
+    };
+
+    std::shared_ptr<MemoryBudget> budget_;
+    std::vector<Shard> shards_;
+    std::atomic<CachePolicy> policy_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+    std::atomic<uint64_t> evictions_ = 0;
+    std::atomic<uint64_t> coalesced_ = 0;
+
+    void put(const key_t &key, const value_t &value, uint64_t size, CacheHint hint,
+             bool loaded) {
+        auto &shard = get_shard(key);
+        uint64_t released = 0;
+        {
+            std::lock_guard guard(shard.mutex);
+            auto it = shard.map.find(key);
+            if (it != shard.map.end()) {
+                released = it->second->size;
+                remove(shard, it->second);
+                shard.map.erase(it);
+            }
+            bool probation;
+            if (hint == CacheHint::scan) {
+                probation = true;
+            } else if (policy_ == CachePolicy::lru) {
+                probation = false;
+            } else {
+                // admitted to the main list if it was evicted from probation recently
+                auto ghost = shard.ghost_map.find(key);
+                probation = ghost == shard.ghost_map.end();
+                if (!probation) {
+                    shard.ghost.erase(ghost->second);
+                    shard.ghost_map.erase(ghost);
+                }
+            }
+            auto &list = probation ? shard.probation : shard.main;
+            list.push_front(
+                Entry{key, value, size, budget_->tick(), probation, hint == CacheHint::scan});
+            shard.map.emplace(key, list.begin());
+            shard.bytes += size;
+            if (probation) shard.probation_bytes += size;
+            // the value is visible now, so new readers don't have to wait
+            if (loaded) shard.loading.erase(key);
+        }
+        // eviction has to happen outside the shard lock
+        budget_->release(released);
+        budget_->charge(size);
+    }
+
+    // needs to hold the shard lock
+    void touch(Shard &shard, typename EntryList::iterator it, CacheHint hint) {
+        if (hint == CacheHint::scan) return;
+        it->time = budget_->tick();
+        it->scan = false;
+        if (it->probation) {
+            // second access, the entry is part of the working set
+            it->probation = false;
+            shard.probation_bytes -= it->size;
+            shard.main.splice(shard.main.begin(), shard.probation, it);
+        } else {
+            shard.main.splice(shard.main.begin(), shard.main, it);
+        }
+    }
+
+    // needs to hold the shard lock
+    void remove(Shard &shard, typename EntryList::iterator it) {
+        shard.bytes -= it->size;
+        if (it->probation) {
+            shard.probation_bytes -= it->size;
+            shard.probation.erase(it);
+        } else {
+            shard.main.erase(it);
+        }
+    }
+
+    // needs to hold the shard lock. probation is drained first once it is over its share, but
+    // its newest entry is kept around so a sequential pass can still reuse the entry it is on
+    [[nodiscard]] bool probation_over_share(const Shard &shard) const {
+        auto percent = policy_ == CachePolicy::two_queue ? probation_percent : 0;
+        return shard.probation.size() > 1 && shard.probation_bytes * 100 > shard.bytes * percent;
+    }
+
+    // needs to hold the shard lock and the shard can't be empty
+    [[nodiscard]] bool victim_in_probation(const Shard &shard) const {
+        if (shard.probation.empty()) return false;
+        if (shard.main.empty() || probation_over_share(shard)) return true;
+        // otherwise both tails compete in lru order
+        return shard.probation.back().time < shard.main.back().time;
+    }
+
+    // needs to hold the shard lock
+    [[nodiscard]] std::optional<EvictionRank> get_victim_rank(const Shard &shard) const {
+        if (shard.map.empty()) return std::nullopt;
+        uint64_t tier = probation_over_share(shard) ? 0 : 1;
+        auto const &list = victim_in_probation(shard) ? shard.probation : shard.main;
+        return EvictionRank{tier, list.back().time};
+    }
+
+    // needs to hold the shard lock and the shard can't be empty. returns the evicted bytes
+    uint64_t evict(Shard &shard) {
+        auto probation = victim_in_probation(shard);
+        auto it = std::prev(probation ? shard.probation.end() : shard.main.end());
+        auto size = it->size;
+        if (probation && !it->scan) {
+            // remember about as many keys as there are entries
+            shard.ghost.push_front(it->key);
+            shard.ghost_map[it->key] = shard.ghost.begin();
+            while (shard.ghost.size() > shard.map.size()) {
+                shard.ghost_map.erase(shard.ghost.back());
+                shard.ghost.pop_back();
+            }
+        }
+        shard.map.erase(it->key);
+        remove(shard, it);
+        return size;
+    }
+
+    [[nodiscard]] uint64_t get_shard_index(const key_t &key) const {
+        // pointer keys are aligned, so the low bits have to be mixed in first
+        auto hash = static_cast<uint64_t>(hash_t()(key)) * 0x9E3779B97F4A7C15ull;
+        return (hash >> 32u) % shards_.size();
+    }
+    Shard &get_shard(const key_t &key) { return shards_[get_shard_index(key)]; }
+    const Shard &get_shard(const key_t &key) const { return shards_[get_shard_index(key)]; }
+};
+
 }  // namespace hermes
 
 #endif  // HERMES_CACHE_HH
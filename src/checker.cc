@@ -1,9 +1,9 @@
 #include "checker.hh"
 
 #include <iostream>
-#include <thread>
 
 #include "fmt/format.h"
+#include "process.hh"
 
 namespace hermes {
 
@@ -11,56 +11,133 @@ void Checker::run(const std::string &transaction_name, const std::shared_ptr<Loa
     auto tables =
         loader->load_transaction_table(transaction_name, 0, std::numeric_limits<uint64_t>::max());
     auto query = std::make_shared<QueryHelper>(loader);
+    cancelled_ = false;
+    current_ptr_ = std::nullopt;
     // depends on whether it is stateless or not
     if (stateless_) {
-        // run it in parallel. each thread gets a table
-        std::vector<std::thread> threads;
-        threads.reserve(tables.size());
-        for (auto const &table : tables) {
-            std::vector<std::pair<bool, const arrow::Table *>> ts = {{false, table.table}};
-            auto thread = std::thread([ts, loader, query, this]() {
-                auto stream = TransactionStream(ts, loader.get());
-                if (assert_exception_) {
-                    try {
-                        for (auto &&it : stream) {
-                            {
-                                std::lock_guard guard(assert_mutex_);
-                                if (current_ptr_) {
-                                    break;
-                                }
-                            }
-                            check(it, query);
-                        }
-                    } catch (const CheckerAssertion &ex) {
-                        std::lock_guard guard(assert_mutex_);
-                        current_ptr_ = std::current_exception();
-                    }
-                } else {
-                    for (auto &&it : stream) {
-                        check(it, query);
-                    }
-                }
-            });
-            threads.emplace_back(std::move(thread));
-        }
-        for (auto &thread : threads) {
-            thread.join();
+        // the stream is split into fixed-size ranges of transactions. workers keep grabbing the
+        // next range, so a large row group doesn't leave the other workers idle
+        std::vector<std::pair<bool, const RowGroupInfo *>> ts;
+        ts.reserve(tables.size());
+        for (auto const &res : tables) {
+            ts.emplace_back(std::make_pair(false, res.row_group));
         }
-        if (assert_exception_ && current_ptr_) {
+        auto stream = TransactionStream(ts, loader.get());
+        stream.set_cache_hint(CacheHint::scan);
+        auto num_morsels = (stream.size() + morsel_size_ - 1) / morsel_size_;
+        std::atomic<uint64_t> next_morsel = 0;
+
+        auto check_morsels = [&](uint64_t) {
+            uint64_t morsel;
+            while (!cancelled_.load(std::memory_order_relaxed) &&
+                   (morsel = next_morsel++) < num_morsels) {
+                auto start = morsel * morsel_size_;
+                auto end = std::min(start + morsel_size_, stream.size());
+                auto it = stream.begin() + start;
+                for (auto row = start; row < end; row++, ++it) {
+                    if (!check_guarded(*it, query)) return;
+                }
+            }
+        };
+        auto &executor = Executor::global();
+        executor.parallel_for(0, executor.num_threads(), check_morsels);
+        if (current_ptr_) {
             std::rethrow_exception(*current_ptr_);
         }
     } else {
         // linear
-        std::vector<std::pair<bool, const arrow::Table *>> ts;
+        std::vector<std::pair<bool, const RowGroupInfo *>> ts;
         ts.reserve(tables.size());
         for (auto const &res : tables) {
-            ts.emplace_back(std::make_pair(false, res.table));
+            ts.emplace_back(std::make_pair(false, res.row_group));
         }
         auto stream = TransactionStream(ts, loader.get());
-        for (auto &&it : stream) {
-            check(it, query);
+        stream.set_cache_hint(CacheHint::scan);
+        if (partition_key_) {
+            run_partitioned(stream, query);
+            if (current_ptr_) {
+                std::rethrow_exception(*current_ptr_);
+            }
+        } else {
+            for (auto &&it : stream) {
+                check(it, query);
+            }
+        }
+    }
+}
+
+void Checker::set_partition_key(const std::string &name) {
+    partition_key_ = [name](const TransactionData &data) -> uint64_t {
+        std::hash<AttributeValue> hash;
+        if (!data.transaction) return 0;
+        auto const &attrs = data.transaction->attrs();
+        auto attr = attrs.find(name);
+        if (attr != attrs.end()) return hash(attr->second);
+        for (auto const &event : *data.events) {
+            auto index = event->schema().find(name);
+            if (index >= 0) return hash(event->slots()[index]);
         }
+        // everything without the key ends up in the same partition
+        return 0;
+    };
+}
+
+void Checker::run_partitioned(const TransactionStream &stream,
+                              const std::shared_ptr<QueryHelper> &query) {
+    auto &executor = Executor::global();
+    auto num_partitions = executor.num_threads();
+    // the stream is processed in batches. decoding and computing the keys can happen in any
+    // order, then every partition walks its own rows of the batch in order. since batches are
+    // processed one after another, each key sees its transactions in stream order
+    auto batch_size = morsel_size_ * num_partitions * 4;
+    std::vector<TransactionData> batch;
+    std::vector<uint64_t> keys;
+    std::vector<std::vector<uint64_t>> partitions(num_partitions);
+
+    for (uint64_t start = 0; start < stream.size(); start += batch_size) {
+        if (cancelled_.load(std::memory_order_relaxed)) break;
+        auto size = std::min(batch_size, stream.size() - start);
+        batch.resize(size);
+        keys.resize(size);
+        auto num_morsels = (size + morsel_size_ - 1) / morsel_size_;
+        executor.parallel_for(0, num_morsels, [&](uint64_t morsel) {
+            auto begin = morsel * morsel_size_;
+            auto end = std::min(begin + morsel_size_, size);
+            auto it = stream.begin() + (start + begin);
+            for (auto i = begin; i < end; i++, ++it) {
+                batch[i] = *it;
+                keys[i] = partition_key_(batch[i]);
+            }
+        });
+
+        for (auto &rows : partitions) rows.clear();
+        for (uint64_t i = 0; i < size; i++) {
+            // user keys are often aligned addresses, so mix the low bits in first
+            auto hash = keys[i] * 0x9E3779B97F4A7C15ull;
+            partitions[(hash >> 32u) % num_partitions].emplace_back(i);
+        }
+
+        executor.parallel_for(0, num_partitions, [&](uint64_t partition) {
+            for (auto i : partitions[partition]) {
+                if (!check_guarded(batch[i], query)) return;
+            }
+        });
+    }
+}
+
+bool Checker::check_guarded(const TransactionData &data,
+                            const std::shared_ptr<QueryHelper> &query) {
+    if (cancelled_.load(std::memory_order_relaxed)) return false;
+    try {
+        check(data, query);
+    } catch (const CheckerAssertion &ex) {
+        if (!assert_exception_) throw;
+        std::lock_guard guard(assert_mutex_);
+        if (!current_ptr_) current_ptr_ = std::current_exception();
+        cancelled_.store(true, std::memory_order_relaxed);
+        return false;
     }
+    return true;
 }
 
 void Checker::assert_(bool value, const std::string &message) const {
@@ -1,7 +1,10 @@
 #ifndef HERMES_CHECKER_HH
 #define HERMES_CHECKER_HH
 
+#include <algorithm>
+#include <atomic>
 #include <exception>
+#include <functional>
 #include <mutex>
 
 #include "loader.hh"
@@ -12,6 +15,12 @@ namespace hermes {
 
 class Checker {
 public:
+    // number of transactions a worker checks before it grabs the next range
+    static constexpr uint64_t default_morsel_size = 256;
+
+    // maps a transaction to its partition key. it is called from multiple workers at once
+    using PartitionKey = std::function<uint64_t(const TransactionData &)>;
+
     Checker() = default;
     virtual void check(const hermes::TransactionData &transaction_data,
                        const std::shared_ptr<QueryHelper> &query) = 0;
@@ -22,6 +31,14 @@ public:
     void set_stateless(bool value) { stateless_ = value; }
     [[nodiscard]] bool assert_exception() const { return assert_exception_; }
     void set_assert_exception(bool value) { assert_exception_ = value; }
+    [[nodiscard]] uint64_t morsel_size() const { return morsel_size_; }
+    void set_morsel_size(uint64_t value) { morsel_size_ = std::max<uint64_t>(value, 1); }
+    // stateful checkers with a partition key run in parallel. transactions with the same key are
+    // always checked by the same worker, in stream order
+    void set_partition_key(PartitionKey func) { partition_key_ = std::move(func); }
+    // key on a transaction attribute, or the first event value with that name
+    void set_partition_key(const std::string &name);
+    [[nodiscard]] bool partitioned() const { return partition_key_ != nullptr; }
 
     void assert_(bool value) const { assert_(value, ""); }
     void assert_(bool value, const std::string &message) const;
@@ -29,8 +46,18 @@ public:
 protected:
     bool stateless_ = true;
     bool assert_exception_ = false;
+    uint64_t morsel_size_ = default_morsel_size;
+    // set once the first assertion is thrown so the other workers stop early
+    std::atomic<bool> cancelled_ = false;
     std::mutex assert_mutex_;
     std::optional<std::exception_ptr> current_ptr_;
+    PartitionKey partition_key_;
+
+private:
+    void run_partitioned(const TransactionStream &stream,
+                         const std::shared_ptr<QueryHelper> &query);
+    // returns false if checking has to stop
+    bool check_guarded(const TransactionData &data, const std::shared_ptr<QueryHelper> &query);
 };
 
 class CheckerAssertion : public std::runtime_error {
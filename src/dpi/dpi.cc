@@ -3,6 +3,7 @@
 #include <filesystem>
 #include <iostream>
 
+#include "pool.hh"
 #include "process.hh"
 #include "serializer.hh"
 #include "tracker.hh"
@@ -10,7 +11,7 @@
 void DPILogger::create_events(uint64_t num_events) {
     std::lock_guard guard(events_lock_);
     events_.resize(num_events);
-    for (auto &ptr : events_) ptr = std::make_shared<hermes::Event>(0);
+    for (auto &ptr : events_) ptr = hermes::make_pooled<hermes::Event>(0);
     if (num_events > max_events_size) {
         std::cerr << "Unable to allocate events which exceeds " << max_events_size << std::endl;
     }
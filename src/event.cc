@@ -1,6 +1,7 @@
 #include "event.hh"
 
 #include <fstream>
+#include <mutex>
 #include <regex>
 #include <variant>
 
@@ -9,30 +10,157 @@
 #include "arrow/ipc/reader.h"
 #include "fmt/format.h"
 #include "parquet/stream_writer.h"
+#include "pool.hh"
 #include "pubsub.hh"
+#include "search.hh"
 
 namespace hermes {
 
-std::atomic<uint64_t> Event::event_id_count_ = 0;
+int EventSchema::find(const std::string &name) const {
+    auto it = std::lower_bound(
+        fields_.begin(), fields_.end(), name,
+        [](const Field &field, const std::string &n) { return *field.name < n; });
+    if (it == fields_.end() || *it->name != name) return -1;
+    return static_cast<int>(std::distance(fields_.begin(), it));
+}
 
-Event::Event(uint64_t time) noexcept : Event("", time) {}
+SchemaRegistry::SchemaRegistry() { empty_ = intern({}); }
+
+SchemaRegistry &SchemaRegistry::global() {
+    static SchemaRegistry registry;
+    return registry;
+}
+
+const EventSchema *SchemaRegistry::get(Fields fields) {
+    std::sort(fields.begin(), fields.end());
+    {
+        std::shared_lock guard(mutex_);
+        auto it = index_.find(fields);
+        if (it != index_.end()) return it->second;
+    }
+    std::unique_lock guard(mutex_);
+    return intern(std::move(fields));
+}
+
+const EventSchema *SchemaRegistry::add(const EventSchema *schema, const std::string &name,
+                                       uint64_t type) {
+    {
+        std::shared_lock guard(mutex_);
+        auto it = schema->add_transitions_.find(name);
+        if (it != schema->add_transitions_.end() && it->second[type]) return it->second[type];
+    }
+    std::unique_lock guard(mutex_);
+    Fields fields;
+    fields.reserve(schema->size() + 1);
+    for (auto const &field : schema->fields_) {
+        if (*field.name != name) fields.emplace_back(*field.name, field.type);
+    }
+    fields.emplace_back(name, type);
+    std::sort(fields.begin(), fields.end());
+    auto const *result = intern(std::move(fields));
+    schema->add_transitions_[name][type] = result;
+    return result;
+}
 
-Event::Event(const std::string &name, uint64_t time) noexcept {
-    add_value(TIME_NAME, time);
-    add_value(ID_NAME, event_id_count_++);
-    add_value(NAME_NAME, name);
+const EventSchema *SchemaRegistry::remove(const EventSchema *schema, const std::string &name) {
+    {
+        std::shared_lock guard(mutex_);
+        auto it = schema->remove_transitions_.find(name);
+        if (it != schema->remove_transitions_.end()) return it->second;
+    }
+    std::unique_lock guard(mutex_);
+    Fields fields;
+    fields.reserve(schema->size());
+    for (auto const &field : schema->fields_) {
+        if (*field.name != name) fields.emplace_back(*field.name, field.type);
+    }
+    auto const *result = intern(std::move(fields));
+    schema->remove_transitions_[name] = result;
+    return result;
+}
+
+uint64_t SchemaRegistry::size() const {
+    std::shared_lock guard(mutex_);
+    return schemas_.size();
 }
 
+const EventSchema *SchemaRegistry::intern(Fields fields) {
+    auto it = index_.find(fields);
+    if (it != index_.end()) return it->second;
+    auto schema = std::make_unique<EventSchema>();
+    schema->id_ = static_cast<uint32_t>(schemas_.size());
+    schema->fields_.reserve(fields.size());
+    for (auto const &[name, type] : fields) {
+        auto const &interned = *names_.emplace(name).first;
+        schema->fields_.emplace_back(EventSchema::Field{&interned, type});
+    }
+    auto const *result = schema.get();
+    schemas_.emplace_back(std::move(schema));
+    index_.emplace(std::move(fields), result);
+    return result;
+}
+
+IdAllocator Event::id_allocator_;
+
+Event::Event(uint64_t time) noexcept : Event("", time) {}
+
+Event::Event(const std::string &name, uint64_t time) noexcept
+    : time_(time),
+      id_(id_allocator_.next()),
+      name_(name),
+      schema_(SchemaRegistry::global().empty()) {}
+
 bool Event::remove_value(const std::string &name) {
-    if (name == TIME_NAME || name == ID_NAME) return false;
-    if (values_.find(name) == values_.end()) return false;
-    values_.erase(name);
+    if (is_fixed_value(name)) return false;
+    auto index = schema_->find(name);
+    if (index < 0) return false;
+    schema_ = SchemaRegistry::global().remove(schema_, name);
+    slots_.erase(slots_.begin() + index);
     return true;
 }
 
-void Event::set_time(uint64_t time) { values_[TIME_NAME] = time; }
+void Event::set_value(const std::string &name, AttributeValue value) {
+    auto index = schema_->find(name);
+    if (index >= 0 && slots_[index].index() == value.index()) {
+        slots_[index] = std::move(value);
+        return;
+    }
+    // the attribute is new or changes its type. either way the transition is cached by the old
+    // schema, so events from the same logger don't rebuild it
+    schema_ = SchemaRegistry::global().add(schema_, name, value.index());
+    if (index >= 0) {
+        slots_[index] = std::move(value);
+    } else {
+        slots_.insert(slots_.begin() + schema_->find(name), std::move(value));
+    }
+}
+
+template <std::size_t... I>
+AttributeValue default_value(uint64_t type, std::index_sequence<I...>) {
+    static const AttributeValue values[] = {AttributeValue(std::in_place_index<I>)...};
+    return values[type];
+}
 
-void Event::set_id(uint64_t id) { values_[ID_NAME] = id; }
+void Event::set_schema(const EventSchema *schema) {
+    schema_ = schema;
+    slots_.clear();
+    slots_.reserve(schema->size());
+    for (uint64_t i = 0; i < schema->size(); i++) {
+        slots_.emplace_back(default_value(
+            schema->type(i), std::make_index_sequence<std::variant_size_v<AttributeValue>>()));
+    }
+}
+
+std::map<std::string, AttributeValue> Event::values() const {
+    std::map<std::string, AttributeValue> result;
+    for (uint64_t i = 0; i < slots_.size(); i++) {
+        result.emplace(schema_->name(i), slots_[i]);
+    }
+    result.emplace(TIME_NAME, time_);
+    result.emplace(ID_NAME, id_);
+    result.emplace(NAME_NAME, name_);
+    return result;
+}
 
 std::shared_ptr<arrow::Schema> get_schema(Event *event) {
     auto const &values = event->values();
@@ -75,7 +203,7 @@ std::unique_ptr<EventBatch> EventBatch::deserialize(const arrow::Table *table) {
     event_batch->reserve(num_rows);
     // create each batch
     for (auto i = 0u; i < num_rows; i++) {
-        event_batch->emplace_back(std::make_shared<Event>(0));
+        event_batch->emplace_back(make_pooled<Event>(0));
     }
 
     auto field_names = table->schema()->field_names();
@@ -89,13 +217,9 @@ std::unique_ptr<EventBatch> EventBatch::deserialize(const arrow::Table *table) {
 bool EventBatch::validate() const noexcept {
     // make sure they have the same schema
     if (empty()) return true;
-    auto const &ref = this->front()->values();
-    for (uint64_t i = 1; i < size(); i++) {
-        auto const &event = (*this)[i];
-        auto const &values = event->values();
-        if (!same_schema(ref, values)) return false;
-    }
-    return true;
+    // schemas are interned and time, id and name always have the same type
+    auto ref = this->front()->schema_id();
+    return std::all_of(begin(), end(), [ref](auto const &e) { return e->schema_id() == ref; });
 }
 
 void EventBatch::sort() {
@@ -117,28 +241,19 @@ Event *EventBatch::get_event(uint64_t id) {
 }
 
 EventBatch::iterator EventBatch::lower_bound(uint64_t time) {
-    if (lower_bound_index_.empty()) {
+    if (time_index_.size() != size()) {
         build_time_index();
     }
-    auto it = lower_bound_index_.lower_bound(time);
-    if (it == lower_bound_index_.end()) {
-        return end();
-    } else {
-        return it->second;
-    }
+    auto index = branchless_lower_bound(time_index_.data(), time_index_.size(), time);
+    return begin() + static_cast<int64_t>(index);
 }
 
 EventBatch::iterator EventBatch::upper_bound(uint64_t time) {
-    if (upper_bounder_index_.empty()) {
+    if (time_index_.size() != size()) {
         build_time_index();
     }
-
-    auto it = upper_bounder_index_.upper_bound(time);
-    if (it == upper_bounder_index_.end()) {
-        return end();
-    } else {
-        return it->second;
-    }
+    auto index = branchless_upper_bound(time_index_.data(), time_index_.size(), time);
+    return begin() + static_cast<int64_t>(index);
 }
 
 bool EventBatch::contains(uint64_t id) {
@@ -154,11 +269,166 @@ void EventBatch::build_id_index() {
     }
 }
 
+void EventBatch::clear_index() {
+    id_index_.clear();
+    time_index_.clear();
+}
+
+uint64_t EventBatch::memory_size() const {
+    // events are allocated together with the shared_ptr control block
+    constexpr uint64_t event_size = sizeof(Event) + sizeof(std::shared_ptr<Event>);
+    uint64_t result = sizeof(EventBatch) + size() * sizeof(std::shared_ptr<Event>);
+    for (auto const &e : *this) {
+        result += event_size + hermes::memory_size(e->slots()) + hermes::memory_size(e->name());
+    }
+    result += hermes::memory_size(id_index_);
+    result += time_index_.capacity() * sizeof(uint64_t);
+    return result;
+}
+
 void EventBatch::build_time_index() {
-    for (auto it = this->begin(); it != this->end(); it++) {
-        lower_bound_index_.try_emplace((*it)->time(), it);
-        upper_bounder_index_[(*it)->time()] = it;
+    // events are sorted by time, so the times form a sorted column
+    time_index_.resize(size());
+    for (uint64_t i = 0; i < size(); i++) {
+        time_index_[i] = (*this)[i]->time();
+    }
+}
+
+uint64_t EventView::time() const { return batch_->time(row_); }
+
+uint64_t EventView::id() const { return batch_->id(row_); }
+
+std::string EventView::name() const {
+    if (!batch_->name().empty()) return batch_->name();
+    auto name = get_value<std::string>(Event::NAME_NAME);
+    return name ? *name : "";
+}
+
+template <typename T>
+std::optional<T> EventView::get_value(const std::string &name) const noexcept {
+    auto idx = batch_->column_index(name);
+    if (idx < 0) return std::nullopt;
+    auto const *column = batch_->column(idx);
+    using ArrowType = typename arrow::CTypeTraits<T>::ArrowType;
+    if (column->type_id() != ArrowType::type_id) return std::nullopt;
+    auto row = static_cast<int64_t>(row_);
+    if (column->IsNull(row)) return std::nullopt;
+    auto const *array = static_cast<const typename arrow::CTypeTraits<T>::ArrayType *>(column);
+    if constexpr (std::is_same_v<T, std::string>) {
+        return array->GetString(row);
+    } else {
+        return array->Value(row);
+    }
+}
+
+template std::optional<uint8_t> EventView::get_value(const std::string &name) const noexcept;
+template std::optional<uint16_t> EventView::get_value(const std::string &name) const noexcept;
+template std::optional<uint32_t> EventView::get_value(const std::string &name) const noexcept;
+template std::optional<uint64_t> EventView::get_value(const std::string &name) const noexcept;
+template std::optional<bool> EventView::get_value(const std::string &name) const noexcept;
+template std::optional<std::string> EventView::get_value(const std::string &name) const noexcept;
+
+bool EventView::has_value(const std::string &name) const noexcept {
+    return batch_->column_index(name) >= 0;
+}
+
+std::shared_ptr<Event> EventView::materialize() const {
+    auto event = make_pooled<Event>(time());
+    event->set_id(id());
+    auto const &fields = batch_->table()->schema()->fields();
+    auto row = static_cast<int64_t>(row_);
+    for (auto i = 0u; i < fields.size(); i++) {
+        auto const &name = fields[i]->name();
+        if (name == Event::TIME_NAME || name == Event::ID_NAME) continue;
+        auto const *column = batch_->column(static_cast<int>(i));
+        switch (column->type_id()) {
+            case arrow::Type::UINT8:
+                event->add_value(name, static_cast<const arrow::UInt8Array *>(column)->Value(row));
+                break;
+            case arrow::Type::UINT16:
+                event->add_value(name, static_cast<const arrow::UInt16Array *>(column)->Value(row));
+                break;
+            case arrow::Type::UINT32:
+                event->add_value(name, static_cast<const arrow::UInt32Array *>(column)->Value(row));
+                break;
+            case arrow::Type::UINT64:
+                event->add_value(name, static_cast<const arrow::UInt64Array *>(column)->Value(row));
+                break;
+            case arrow::Type::BOOL:
+                event->add_value(name,
+                                 static_cast<const arrow::BooleanArray *>(column)->Value(row));
+                break;
+            case arrow::Type::STRING:
+                event->add_value(name,
+                                 static_cast<const arrow::StringArray *>(column)->GetString(row));
+                break;
+            default:
+                auto error_msg = fmt::format("Unknown type {0} for column {1}",
+                                             column->type()->ToString(), name);
+                throw std::runtime_error(error_msg);
+        }
     }
+    if (!batch_->name().empty()) event->set_name(batch_->name());
+    return event;
+}
+
+std::unique_ptr<ColumnarEventBatch> ColumnarEventBatch::deserialize(
+    const std::shared_ptr<arrow::Table> &table) {
+    // a single row group is usually decoded into one chunk, in which case this is zero-copy
+    auto combined = table->CombineChunks();
+    if (!combined.ok()) return nullptr;
+
+    auto batch = std::make_unique<ColumnarEventBatch>();
+    batch->table_ = *combined;
+    batch->num_rows_ = batch->table_->num_rows();
+    auto const &fields = batch->table_->schema()->fields();
+    batch->columns_.reserve(fields.size());
+    for (auto i = 0u; i < fields.size(); i++) {
+        batch->column_index_.emplace(fields[i]->name(), static_cast<int>(i));
+        auto const &chunks = batch->table_->column(static_cast<int>(i));
+        if (chunks->num_chunks() > 0) {
+            batch->columns_.emplace_back(chunks->chunk(0));
+        } else {
+            auto r = arrow::MakeArrayOfNull(fields[i]->type(), 0);
+            if (!r.ok()) return nullptr;
+            batch->columns_.emplace_back(*r);
+        }
+    }
+
+    // time and id are accessed on every row, so we keep raw pointers to them
+    auto get_raw = [&batch](const std::string &name, const uint64_t *&values) -> bool {
+        auto idx = batch->column_index(name);
+        if (idx < 0) return false;
+        auto const &column = batch->columns_[idx];
+        if (column->type_id() != arrow::Type::UINT64) return false;
+        values = std::static_pointer_cast<arrow::UInt64Array>(column)->raw_values();
+        return true;
+    };
+    if (!get_raw(Event::TIME_NAME, batch->times_) || !get_raw(Event::ID_NAME, batch->ids_)) {
+        return nullptr;
+    }
+
+    return batch;
+}
+
+uint64_t ColumnarEventBatch::lower_bound(uint64_t time) const {
+    return branchless_lower_bound(times_, num_rows_, time);
+}
+
+uint64_t ColumnarEventBatch::upper_bound(uint64_t time) const {
+    return branchless_upper_bound(times_, num_rows_, time);
+}
+
+int ColumnarEventBatch::column_index(const std::string &name) const {
+    auto it = column_index_.find(name);
+    if (it == column_index_.end()) return -1;
+    return it->second;
+}
+
+std::unique_ptr<EventBatch> ColumnarEventBatch::materialize() const {
+    auto events = EventBatch::deserialize(table_.get());
+    if (!name_.empty()) events->set_name(name_);
+    return events;
 }
 
 enum class ValueType { Int, Hex, Str, Time };
@@ -242,7 +512,7 @@ bool parse_event_log_fmt(const std::string &filename, const std::string &event_n
         std::smatch matches;
         if (std::regex_search(line, matches, re)) {
             // new event
-            auto event = std::make_shared<Event>(0);
+            auto event = make_pooled<Event>(0);
             event->set_name(event_name);
             // convert types and log values
             for (auto i = 1u; i < matches.size(); i++) {
@@ -280,6 +550,34 @@ bool parse_event_log_fmt(const std::string &filename, const std::string &event_n
     return true;
 }
 
+uint64_t memory_size(const std::vector<AttributeValue> &values) {
+    // the names are kept by the shared schema
+    uint64_t result = values.capacity() * sizeof(AttributeValue);
+    for (auto const &v : values) {
+        if (auto const *str = std::get_if<std::string>(&v)) result += memory_size(*str);
+    }
+    return result;
+}
+
+uint64_t memory_size(const std::string &str) {
+    // short strings are stored inline
+    static const auto inline_capacity = std::string().capacity();
+    return str.capacity() > inline_capacity ? str.capacity() + 1 : 0;
+}
+
+uint64_t memory_size(const std::map<std::string, AttributeValue> &values) {
+    constexpr uint64_t node_size =
+        sizeof(std::pair<const std::string, AttributeValue>) + 4 * sizeof(void *);
+    uint64_t result = values.size() * node_size;
+    for (auto const &[name, value] : values) {
+        result += memory_size(name);
+        if (auto const *str = std::get_if<std::string>(&value)) {
+            result += memory_size(*str);
+        }
+    }
+    return result;
+}
+
 bool same_schema(const std::map<std::string, AttributeValue> &ref,
                  const std::map<std::string, AttributeValue> &target) {
     if (target.size() != ref.size()) return false;
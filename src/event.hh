@@ -1,16 +1,22 @@
 #ifndef HERMES_EVENT_HH
 #define HERMES_EVENT_HH
 
+#include <array>
 #include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
 #include <vector>
 
 namespace arrow {
+class Array;
 class RecordBatch;
 class Schema;
 class Table;
@@ -20,6 +26,113 @@ namespace hermes {
 
 using AttributeValue = std::variant<uint64_t, uint32_t, uint16_t, uint8_t, bool, std::string>;
 
+// hands out unique ids. each thread leases a block of consecutive ids from the shared counter,
+// so threads don't contend on it and the ids inside a block stay dense
+class IdAllocator {
+public:
+    static constexpr uint64_t block_size = 1024;
+
+    IdAllocator() : index_(num_allocators()++) {}
+
+    uint64_t next() {
+        auto &blocks = local_blocks();
+        if (blocks.size() <= index_) blocks.resize(index_ + 1);
+        auto &block = blocks[index_];
+        auto generation = generation_.load(std::memory_order_acquire);
+        if (block.next == block.end || block.generation != generation) {
+            block.next = counter_.fetch_add(block_size, std::memory_order_relaxed);
+            block.end = block.next + block_size;
+            block.generation = generation;
+        }
+        return block.next++;
+    }
+
+    // restarts from 0. blocks leased before the reset are dropped the next time each thread
+    // asks for an id
+    void reset() {
+        counter_ = 0;
+        generation_.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    struct Block {
+        uint64_t next = 0;
+        uint64_t end = 0;
+        uint64_t generation = 0;
+    };
+
+    uint64_t index_;
+    std::atomic<uint64_t> counter_ = 0;
+    std::atomic<uint64_t> generation_ = 0;
+
+    static std::atomic<uint64_t> &num_allocators() {
+        static std::atomic<uint64_t> count = 0;
+        return count;
+    }
+    static std::vector<Block> &local_blocks() {
+        thread_local std::vector<Block> blocks;
+        return blocks;
+    }
+};
+
+// attribute names and types shared by every event that carries the same attributes. schemas are
+// interned by the registry and never freed, so two events have the same schema iff they point
+// to the same one
+class EventSchema {
+public:
+    [[nodiscard]] uint32_t id() const { return id_; }
+    [[nodiscard]] uint64_t size() const { return fields_.size(); }
+    [[nodiscard]] const std::string &name(uint64_t index) const { return *fields_[index].name; }
+    // index of the alternative in AttributeValue
+    [[nodiscard]] uint64_t type(uint64_t index) const { return fields_[index].type; }
+    // -1 if the attribute does not exist
+    [[nodiscard]] int find(const std::string &name) const;
+
+private:
+    friend class SchemaRegistry;
+    struct Field {
+        const std::string *name;
+        uint64_t type;
+    };
+
+    uint32_t id_ = 0;
+    // sorted by name
+    std::vector<Field> fields_;
+    // schemas reached by adding or removing one attribute, guarded by the registry lock
+    mutable std::unordered_map<std::string,
+                               std::array<const EventSchema *, std::variant_size_v<AttributeValue>>>
+        add_transitions_;
+    mutable std::unordered_map<std::string, const EventSchema *> remove_transitions_;
+};
+
+// process-wide registry of event schemas. attribute names are interned so each one is stored once
+class SchemaRegistry {
+public:
+    using Fields = std::vector<std::pair<std::string, uint64_t>>;
+
+    SchemaRegistry();
+    static SchemaRegistry &global();
+
+    [[nodiscard]] const EventSchema *empty() const { return empty_; }
+    // fields can be in any order
+    const EventSchema *get(Fields fields);
+    // schema with the attribute added, or with its type changed if it already exists
+    const EventSchema *add(const EventSchema *schema, const std::string &name, uint64_t type);
+    const EventSchema *remove(const EventSchema *schema, const std::string &name);
+
+    [[nodiscard]] uint64_t size() const;
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::unordered_set<std::string> names_;
+    std::vector<std::unique_ptr<EventSchema>> schemas_;
+    std::map<Fields, const EventSchema *> index_;
+    const EventSchema *empty_;
+
+    // fields have to be sorted and the lock held
+    const EventSchema *intern(Fields fields);
+};
+
 class Event : public std::enable_shared_from_this<Event> {
 public:
     static constexpr auto TIME_NAME = "time";
@@ -31,39 +144,106 @@ public:
 
     template <typename T>
     void add_value(const std::string &name, const T &value) noexcept {
-        values_[name] = value;
+        if (is_fixed_value(name)) {
+            set_fixed_value(name, value);
+        } else {
+            AttributeValue v = value;
+            set_value(name, std::move(v));
+        }
     }
 
     template <typename T>
     std::optional<T> get_value(const std::string &name) const noexcept {
-        if (values_.find(name) == values_.end()) {
+        if (is_fixed_value(name)) return get_fixed_value<T>(name);
+        auto index = schema_->find(name);
+        if (index < 0) {
             return std::nullopt;
         } else {
-            auto const &entry = values_.at(name);
-            return std::get<T>(entry);
+            return std::get<T>(slots_[index]);
         }
     }
 
     bool remove_value(const std::string &name);
     [[nodiscard]] bool has_value(const std::string &name) const noexcept {
-        return values_.find(name) != values_.end();
+        return is_fixed_value(name) || schema_->find(name) >= 0;
     }
 
-    [[nodiscard]] uint64_t time() const { return *get_value<uint64_t>(TIME_NAME); }
-    void set_time(uint64_t time);
-    [[nodiscard]] uint64_t id() const { return *get_value<uint64_t>(ID_NAME); }
-    void set_id(uint64_t id);
-    [[nodiscard]] std::string name() const { return *get_value<std::string>(NAME_NAME); }
-    void set_name(const std::string &name) { add_value(NAME_NAME, name); }
+    [[nodiscard]] uint64_t time() const { return time_; }
+    void set_time(uint64_t time) { time_ = time; }
+    [[nodiscard]] uint64_t id() const { return id_; }
+    void set_id(uint64_t id) { id_ = id; }
+    [[nodiscard]] const std::string &name() const { return name_; }
+    void set_name(const std::string &name) { name_ = name; }
+
+    // calls func(name, value) for time, id, name and then every attribute in schema order.
+    // values are passed with their concrete type, so nothing is copied
+    template <typename F>
+    void for_each_value(F &&func) const {
+        func(TIME_NAME, time_);
+        func(ID_NAME, id_);
+        func(NAME_NAME, name_);
+        for (uint64_t i = 0; i < slots_.size(); i++) {
+            auto const *name = schema_->name(i).c_str();
+            std::visit([&func, name](auto const &value) { func(name, value); }, slots_[i]);
+        }
+    }
+
+    // all the values, including time, id and name. the map is composed on every call, so it is
+    // only meant for bulk export. use the accessors or for_each_value() instead
+    [[nodiscard]] std::map<std::string, AttributeValue> values() const;
+
+    // attributes other than time, id and name. slots are in schema order
+    [[nodiscard]] const EventSchema &schema() const { return *schema_; }
+    [[nodiscard]] uint32_t schema_id() const { return schema_->id(); }
+    [[nodiscard]] const std::vector<AttributeValue> &slots() const { return slots_; }
+    // writes a value by its index in schema(), skipping the name lookup. the type has to match
+    template <typename T>
+    void set_slot(uint64_t index, T value) {
+        std::get<T>(slots_[index]) = std::move(value);
+    }
+    // drops all the attributes and sets every slot of the new schema to a default value
+    void set_schema(const EventSchema *schema);
 
-    [[nodiscard]] auto const &values() const { return values_; }
+    void static reset_id() { id_allocator_.reset(); }
 
-    void static reset_id() { event_id_count_ = 0; }
+    [[nodiscard]] static bool is_fixed_value(const std::string &name) noexcept {
+        return name == TIME_NAME || name == ID_NAME || name == NAME_NAME;
+    }
 
 private:
-    std::map<std::string, AttributeValue> values_;
+    uint64_t time_;
+    uint64_t id_;
+    std::string name_;
+    const EventSchema *schema_;
+    std::vector<AttributeValue> slots_;
 
-    static std::atomic<uint64_t> event_id_count_;
+    void set_value(const std::string &name, AttributeValue value);
+
+    template <typename T>
+    void set_fixed_value(const std::string &name, const T &value) noexcept {
+        if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+            if (name == TIME_NAME) {
+                time_ = value;
+            } else if (name == ID_NAME) {
+                id_ = value;
+            }
+        } else if constexpr (std::is_constructible_v<std::string, const T &>) {
+            if (name == NAME_NAME) name_ = value;
+        }
+    }
+
+    template <typename T>
+    std::optional<T> get_fixed_value(const std::string &name) const noexcept {
+        if constexpr (std::is_same_v<T, uint64_t>) {
+            if (name == TIME_NAME) return time_;
+            if (name == ID_NAME) return id_;
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            if (name == NAME_NAME) return name_;
+        }
+        return std::nullopt;
+    }
+
+    static IdAllocator id_allocator_;
 };
 
 // template class to visit event values
@@ -110,7 +290,18 @@ public:
     inline void resize(size_t size, const Type &value) {
         array_.resize(size, value);
     }
-    void clear() { array_.clear(); }
+    void clear() {
+        array_.clear();
+        clear_index();
+    }
+    // moves all entries into other and leaves this batch empty. the name is copied over
+    void move_to(Batch<T, K> &other) {
+        other.array_ = std::move(array_);
+        other.name_ = name_;
+        other.clear_index();
+        array_.clear();
+        clear_index();
+    }
     const std::shared_ptr<T> &operator[](uint64_t index) const { return array_[index]; }
     std::shared_ptr<T> &operator[](uint64_t index) { return array_[index]; }
 
@@ -129,6 +320,10 @@ public:
 
     virtual ~Batch() = default;
 
+protected:
+    // drops the lookup structures that point into the entries
+    virtual void clear_index() {}
+
 private:
     std::vector<std::shared_ptr<T>> array_;
     std::string name_;
@@ -153,12 +348,100 @@ public:
 
     void build_id_index();
 
+    // estimated resident bytes, including all the events
+    [[nodiscard]] uint64_t memory_size() const;
+
 private:
     std::unordered_map<uint64_t, Event *> id_index_;
-    std::map<uint64_t, EventBatch::iterator> lower_bound_index_;
-    std::map<uint64_t, EventBatch::iterator> upper_bounder_index_;
+    // event times in batch order, searched by lower_bound and upper_bound
+    std::vector<uint64_t> time_index_;
 
     void build_time_index();
+    void clear_index() override;
+};
+
+class ColumnarEventBatch;
+// lightweight read-only view of a single row inside a columnar event batch.
+// values are read directly from the arrow buffers without any copy
+class EventView {
+public:
+    EventView(const ColumnarEventBatch *batch, uint64_t row) : batch_(batch), row_(row) {}
+
+    [[nodiscard]] uint64_t time() const;
+    [[nodiscard]] uint64_t id() const;
+    [[nodiscard]] std::string name() const;
+
+    template <typename T>
+    std::optional<T> get_value(const std::string &name) const noexcept;
+    [[nodiscard]] bool has_value(const std::string &name) const noexcept;
+
+    // convert to a regular event if the caller needs ownership
+    [[nodiscard]] std::shared_ptr<Event> materialize() const;
+
+    [[nodiscard]] uint64_t row() const { return row_; }
+
+private:
+    const ColumnarEventBatch *batch_;
+    uint64_t row_;
+};
+
+// event batch that keeps the decoded arrow columns instead of creating
+// one event object per row
+class ColumnarEventBatch {
+public:
+    struct iterator {
+    public:
+        iterator(const ColumnarEventBatch *batch, uint64_t row) : batch_(batch), row_(row) {}
+        EventView operator*() const { return EventView(batch_, row_); }
+        inline iterator &operator++() {
+            row_++;
+            return *this;
+        }
+        friend bool operator==(const iterator &a, const iterator &b) { return a.row_ == b.row_; }
+        friend bool operator!=(const iterator &a, const iterator &b) { return a.row_ != b.row_; }
+
+    private:
+        const ColumnarEventBatch *batch_;
+        uint64_t row_;
+    };
+
+    // factory method to construct the batch. returns nullptr if the table does not
+    // have a valid event schema
+    static std::unique_ptr<ColumnarEventBatch> deserialize(
+        const std::shared_ptr<arrow::Table> &table);
+
+    [[nodiscard]] uint64_t size() const { return num_rows_; }
+    [[nodiscard]] bool empty() const { return num_rows_ == 0; }
+    EventView operator[](uint64_t index) const { return EventView(this, index); }
+    [[nodiscard]] iterator begin() const { return iterator(this, 0); }
+    [[nodiscard]] iterator end() const { return iterator(this, num_rows_); }
+
+    // events are stored in time order, so these are binary searches over the time column
+    [[nodiscard]] uint64_t lower_bound(uint64_t time) const;
+    [[nodiscard]] uint64_t upper_bound(uint64_t time) const;
+
+    [[nodiscard]] uint64_t time(uint64_t row) const { return times_[row]; }
+    [[nodiscard]] uint64_t id(uint64_t row) const { return ids_[row]; }
+
+    // -1 if the column does not exist
+    [[nodiscard]] int column_index(const std::string &name) const;
+    [[nodiscard]] const arrow::Array *column(int index) const { return columns_[index].get(); }
+    [[nodiscard]] const std::shared_ptr<arrow::Table> &table() const { return table_; }
+
+    void set_name(const std::string &name) { name_ = name; }
+    [[nodiscard]] const std::string &name() const { return name_; }
+
+    // copy everything into a regular event batch
+    [[nodiscard]] std::unique_ptr<EventBatch> materialize() const;
+
+private:
+    std::shared_ptr<arrow::Table> table_;
+    std::vector<std::shared_ptr<arrow::Array>> columns_;
+    std::unordered_map<std::string, int> column_index_;
+    uint64_t num_rows_ = 0;
+    const uint64_t *times_ = nullptr;
+    const uint64_t *ids_ = nullptr;
+    std::string name_;
 };
 
 // helper functions
@@ -172,6 +455,17 @@ bool parse_event_log_fmt(const std::string &filename, const std::string &event_n
 bool same_schema(const std::map<std::string, AttributeValue> &ref,
                  const std::map<std::string, AttributeValue> &target);
 
+// estimated heap usage, used to charge caches by resident bytes
+uint64_t memory_size(const std::string &str);
+uint64_t memory_size(const std::map<std::string, AttributeValue> &values);
+uint64_t memory_size(const std::vector<AttributeValue> &values);
+template <typename K, typename V>
+uint64_t memory_size(const std::unordered_map<K, V> &map) {
+    // one node per entry plus the bucket array
+    return map.size() * (sizeof(std::pair<const K, V>) + sizeof(void *)) +
+           map.bucket_count() * sizeof(void *);
+}
+
 }  // namespace hermes
 
 #endif  // HERMES_EVENT_HH
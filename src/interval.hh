@@ -0,0 +1,73 @@
+#ifndef HERMES_INTERVAL_HH
+#define HERMES_INTERVAL_HH
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace hermes {
+
+// static index over closed intervals [min, max]. entries are sorted by the lower bound and we
+// keep a running maximum of the upper bound, so a lookup is two binary searches plus a scan over
+// the candidates. row groups are mostly disjoint and written in order, so nearly every candidate
+// is a hit and a lookup is O(log n + k)
+template <typename T>
+class IntervalIndex {
+public:
+    void add(uint64_t min, uint64_t max, T value) {
+        entries_.emplace_back(Entry{min, max, std::move(value)});
+    }
+
+    // has to be called after all the intervals are added
+    void build() {
+        // stable so that entries with the same lower bound keep the insertion order
+        std::stable_sort(entries_.begin(), entries_.end(),
+                         [](const Entry &a, const Entry &b) { return a.min < b.min; });
+        max_prefix_.resize(entries_.size());
+        uint64_t current = 0;
+        for (uint64_t i = 0; i < entries_.size(); i++) {
+            current = std::max(current, entries_[i].max);
+            max_prefix_[i] = current;
+        }
+    }
+
+    // calls func on every value whose interval overlaps with [min, max], ordered by the lower
+    // bound
+    template <typename F>
+    void query(uint64_t min, uint64_t max, F &&func) const {
+        // everything after end starts too late
+        auto end = std::upper_bound(entries_.begin(), entries_.end(), max,
+                                    [](uint64_t v, const Entry &e) { return v < e.min; });
+        auto end_idx = static_cast<uint64_t>(std::distance(entries_.begin(), end));
+        // everything before begin ends too early
+        auto begin = std::lower_bound(max_prefix_.begin(), max_prefix_.begin() + end_idx, min);
+        auto begin_idx = static_cast<uint64_t>(std::distance(max_prefix_.begin(), begin));
+        for (auto i = begin_idx; i < end_idx; i++) {
+            auto const &entry = entries_[i];
+            if (entry.max >= min) func(entry.value);
+        }
+    }
+
+    [[nodiscard]] std::vector<T> query(uint64_t min, uint64_t max) const {
+        std::vector<T> result;
+        query(min, max, [&result](const T &value) { result.emplace_back(value); });
+        return result;
+    }
+
+    [[nodiscard]] uint64_t size() const { return entries_.size(); }
+    [[nodiscard]] bool empty() const { return entries_.empty(); }
+
+private:
+    struct Entry {
+        uint64_t min;
+        uint64_t max;
+        T value;
+    };
+    std::vector<Entry> entries_;
+    std::vector<uint64_t> max_prefix_;
+};
+
+}  // namespace hermes
+
+#endif  // HERMES_INTERVAL_HH
@@ -9,32 +9,12 @@ rapidjson::Value serialize(rapidjson::MemoryPoolAllocator<> &allocator,
                            const std::shared_ptr<Event> &event) {
     using namespace rapidjson;
     Value result(kObjectType);
-    auto const &values = event->values();
     set_member(result, allocator, "type", "event");
     Value event_data(kObjectType);
 
-    for (auto const &[name, v] : values) {
-        auto const *name_ptr = name.c_str();
-        std::visit(overloaded{[&event_data, &allocator, name_ptr](uint8_t v) {
-                                  set_member(event_data, allocator, name_ptr, v);
-                              },
-                              [&event_data, &allocator, name_ptr](uint16_t v) {
-                                  set_member(event_data, allocator, name_ptr, v);
-                              },
-                              [&event_data, &allocator, name_ptr](uint32_t v) {
-                                  set_member(event_data, allocator, name_ptr, v);
-                              },
-                              [&event_data, &allocator, name_ptr](uint64_t v) {
-                                  set_member(event_data, allocator, name_ptr, v);
-                              },
-                              [&event_data, &allocator, name_ptr](bool v) {
-                                  set_member(event_data, allocator, name_ptr, v);
-                              },
-                              [&event_data, &allocator, name_ptr](const std::string &v) {
-                                  set_member(event_data, allocator, name_ptr, v);
-                              }},
-                   v);
-    }
+    event->for_each_value([&event_data, &allocator](const char *name, const auto &v) {
+        set_member(event_data, allocator, name, v);
+    });
     set_member(result, allocator, "value", event_data);
 
     return result;
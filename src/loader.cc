@@ -1,9 +1,13 @@
 #include "loader.hh"
 
+#include <deque>
 #include <filesystem>
+#include <fnmatch.h>
 #include <fstream>
 #include <iostream>
-#include <thread>
+#include <numeric>
+#include <tuple>
+#include <variant>
 
 #include "arrow/api.h"
 #include "arrow/filesystem/localfs.h"
@@ -34,17 +38,9 @@ std::string FileInfo::type_str(FileType type) {
     return "";
 }
 
-void load_transaction(TransactionData &data, Loader *loader) {
-    data.events = std::make_shared<EventBatch>();
-    auto events = loader->get_events(*data.transaction);
-    data.events->reserve(events->size());
-    for (auto const &e : *events) {
-        data.events->emplace_back(e);
-    }
-}
-
 void load_transaction_group(TransactionData::TransactionGroupData &data, Loader *loader) {
     // assume the group is already set
+    // events are resolved afterwards for the whole group at once
     auto const &ts = data.group->transactions();
     auto const &masks = data.group->transaction_masks();
     data.values.reserve(ts.size());
@@ -58,13 +54,33 @@ void load_transaction_group(TransactionData::TransactionGroupData &data, Loader
             load_transaction_group(*d.group, loader);
         } else {
             d.transaction = loader->get_transaction(tid);
-            // load the event and get the events
-            load_transaction(d, loader);
         }
         data.values.emplace_back(d);
     }
 }
 
+void collect_transactions(TransactionData::TransactionGroupData &data,
+                          std::vector<TransactionData *> &result) {
+    for (auto &d : data.values) {
+        if (d.group) {
+            collect_transactions(*d.group, result);
+        } else if (d.transaction) {
+            result.emplace_back(&d);
+        }
+    }
+}
+
+void load_group_events(const std::vector<TransactionData *> &data, Loader *loader,
+                       CacheHint hint) {
+    std::vector<std::shared_ptr<Transaction>> transactions;
+    transactions.reserve(data.size());
+    for (auto const *d : data) transactions.emplace_back(d->transaction);
+    auto events = loader->get_events(transactions, hint);
+    for (uint64_t i = 0; i < data.size(); i++) {
+        data[i]->events = std::move(events[i]);
+    }
+}
+
 TransactionDataIter::TransactionDataIter(const TransactionStream *stream, uint64_t current_row)
     : stream_(stream), current_row_(current_row) {
     // compute the index
@@ -75,35 +91,39 @@ void TransactionDataIter::compute_index() {
     if (current_row_ >= stream_->size()) {
         return;
     }
-    // need to load transactions
-    // figure out which table to load
-    // depends this is a index-mapped tables or not, we need to compute the table
-    // differently
+    // last table that starts at or before the current row. empty tables have the same offset
+    // as the next one, so they are skipped
+    auto const &offsets = stream_->offsets_;
+    auto it = std::upper_bound(offsets.begin(), offsets.end(), current_row_);
+    table_ = static_cast<uint64_t>(std::distance(offsets.begin(), it)) - 1;
+    offset_ = current_row_ - offsets[table_];
+    if (stream_->row_mapping_) row_ = (*stream_->row_mapping_)[table_].at(offset_);
+    update_entry();
+}
+
+void TransactionDataIter::next() {
+    current_row_++;
+    if (current_row_ >= stream_->size()) {
+        return;
+    }
+    auto const &offsets = stream_->offsets_;
+    auto table = table_;
+    while (current_row_ >= offsets[table_ + 1]) table_++;
+    offset_ = current_row_ - offsets[table_];
     if (stream_->row_mapping_) {
-        // compute the table and index
-        // maybe a slightly more optimized way to compute this
-        auto const &mapping = *stream_->row_mapping_;
-        uint64_t table_index = 0;
-        table_index_ = current_row_;
-        for (table_index = 0; table_index < mapping.size(); table_index++) {
-            if (table_index_ >= mapping[table_index].size()) {
-                table_index_ -= mapping[table_index].size();
-            } else {
-                break;
-            }
+        if (table == table_) {
+            ++row_;
+        } else {
+            row_ = (*stream_->row_mapping_)[table_].begin();
         }
-        auto it = stream_->tables_.begin();
-        std::advance(it, table_index);
-        table_entry_ = it->second;
-        // use the mapping
-        table_index_ = mapping[table_index][table_index_];
-    } else {
-        auto table_iter = stream_->tables_.upper_bound(current_row_);
-        table_entry_ = table_iter->second;
-        // compute the index
-        auto offset = table_iter->first - current_row_;
-        table_index_ = table_entry_.second->num_rows() - offset;
     }
+    update_entry();
+}
+
+void TransactionDataIter::update_entry() {
+    table_entry_ = stream_->tables_[table_];
+    // filtered streams only keep the selected rows of each table
+    table_index_ = stream_->row_mapping_ ? *row_ : offset_;
 }
 
 TransactionData TransactionDataIter::operator*() const {
@@ -113,76 +133,96 @@ TransactionData TransactionDataIter::operator*() const {
     }
 
     auto const &[is_group, table] = table_entry_;
+    auto hint = stream_->cache_hint_;
 
     if (is_group) {
-        auto groups = stream_->loader_->load_transaction_groups(table);
+        auto groups = stream_->loader_->load_transaction_groups(table, hint);
         data.group = TransactionData::TransactionGroupData();
         data.group->group = (*groups)[table_index_];
 
         // recursively construct the values
         load_transaction_group(*data.group, stream_->loader_);
+        std::vector<TransactionData *> transactions;
+        collect_transactions(*data.group, transactions);
+        load_group_events(transactions, stream_->loader_, hint);
     } else {
-        auto transactions = stream_->loader_->load_transactions(table);
+        auto transactions = stream_->loader_->load_transactions(table, hint);
         data.transaction = (*transactions)[table_index_];
-        load_transaction(data, stream_->loader_);
+        data.events = stream_->loader_->get_events(*data.transaction, hint);
     }
 
     return data;
 }
 
 TransactionStream::TransactionStream(
-    const std::vector<std::pair<bool, const arrow::Table *>> &tables, Loader *loader)
-    : loader_(loader) {
-    num_entries_ = 0;
-    for (auto const &[group, table] : tables) {
-        num_entries_ += table->num_rows();
-        tables_.emplace(num_entries_, std::make_pair(group, table));
+    const std::vector<std::pair<bool, const RowGroupInfo *>> &tables, Loader *loader)
+    : tables_(tables), loader_(loader) {
+    offsets_.reserve(tables.size() + 1);
+    for (auto const &entry : tables) {
+        offsets_.emplace_back(offsets_.back() + entry.second->num_rows);
     }
+    num_entries_ = offsets_.back();
 }
 
 TransactionStream TransactionStream::where(
     const std::function<bool(const TransactionData &)> &filter) const {
+    // every row is only visited once by the filter
+    auto scan = *this;
+    scan.cache_hint_ = CacheHint::scan;
     // we split jobs on the tables.
-    std::vector<std::vector<uint64_t>> row_mapping;
-    // get original tables
-    std::vector<std::pair<bool, const arrow::Table *>> tables;
-    tables.reserve(tables_.size());
-    for (auto const &iter : tables_) {
-        tables.emplace_back(iter.second);
-    }
-    row_mapping.resize(tables_.size());
-
-    std::vector<std::thread> threads;
-    threads.reserve(tables.size());
-    for (uint64_t idx = 0; idx < tables.size(); idx++) {  // NOLINT
-        auto const &table_entry = tables[idx];
-        // assume the result will be 1/3 or the original size for each
-        // table
-        row_mapping.reserve(table_entry.second->num_rows() / 3);
-        threads.emplace_back(std::thread([idx, table_entry, filter, &row_mapping, this]() {
-            uint64_t i = 0;
-            TransactionStream stream;
-            if (row_mapping_) {
-                stream = TransactionStream({table_entry}, loader_, {(*row_mapping_)[idx]});
-            } else {
-                stream = TransactionStream({table_entry}, loader_);
-            }
-            for (auto const &data : stream) {
-                if (filter(data)) {
-                    if (row_mapping_) {
-                        row_mapping[idx].emplace_back((*row_mapping_)[idx][i]);
-                    } else {
-                        row_mapping[idx].emplace_back(i);
-                    }
-                }
-                i++;
-            }
-        }));
-    }
+    auto row_mapping = std::make_shared<std::vector<RowBitmap>>(tables_.size());
+
+    Executor::global().parallel_for(0, tables_.size(), [&](uint64_t idx) {
+        auto &selection = (*row_mapping)[idx];
+        auto it = TransactionDataIter(&scan, offsets_[idx]);
+        auto end = TransactionDataIter(&scan, offsets_[idx + 1]);
+        // rows of the row group that are selected by this stream
+        auto rows = row_mapping_ ? (*row_mapping_)[idx].begin() : RowBitmap::iterator();
+        for (uint64_t i = 0; it != end; ++it, i++) {
+            auto row = row_mapping_ ? *rows : i;
+            if (filter(*it)) selection.add(row);
+            if (row_mapping_) ++rows;
+        }
+        selection.optimize();
+    });
 
-    for (auto &thread : threads) thread.join();
+    auto result = TransactionStream(tables_, loader_, std::move(row_mapping));
+    result.cache_hint_ = cache_hint_;
+    return result;
+}
 
-    return TransactionStream(tables, loader_, row_mapping);
+TransactionStream TransactionStream::intersect(const TransactionStream &other) const {
+    return combine(other, true);
+}
+
+TransactionStream TransactionStream::unite(const TransactionStream &other) const {
+    return combine(other, false);
+}
+
+TransactionStream TransactionStream::combine(const TransactionStream &other,
+                                             bool intersect) const {
+    if (tables_ != other.tables_) {
+        std::cerr << "[ERROR]: streams are not filtered from the same stream" << std::endl;
+        return TransactionStream();
+    }
+    // stored selections are used in place. only an unfiltered side is materialized as a range
+    auto get_selection = [](const TransactionStream &stream, uint64_t idx,
+                            RowBitmap &all) -> const RowBitmap & {
+        if (stream.row_mapping_) return (*stream.row_mapping_)[idx];
+        all = RowBitmap::range(0, stream.tables_[idx].second->num_rows);
+        return all;
+    };
+    auto row_mapping = std::make_shared<std::vector<RowBitmap>>();
+    row_mapping->reserve(tables_.size());
+    RowBitmap all_a, all_b;
+    for (uint64_t idx = 0; idx < tables_.size(); idx++) {
+        auto const &a = get_selection(*this, idx, all_a);
+        auto const &b = get_selection(other, idx, all_b);
+        row_mapping->emplace_back(intersect ? a & b : a | b);
+    }
+    auto result = TransactionStream(tables_, loader_, std::move(row_mapping));
+    result.cache_hint_ = cache_hint_;
+    return result;
 }
 
 rapidjson::Value get_json_value(const TransactionData &data,
@@ -228,15 +268,14 @@ std::string TransactionStream::json() const {
 }
 
 TransactionStream::TransactionStream(
-    const std::vector<std::pair<bool, const arrow::Table *>> &tables, Loader *loader,
-    std::vector<std::vector<uint64_t>> row_mapping)
-    : loader_(loader), row_mapping_(std::move(row_mapping)) {
-    num_entries_ = 0;
-    for (uint64_t i = 0; i < tables.size(); i++) {
-        auto const &maps = (*row_mapping_)[i];
-        num_entries_ += maps.size();
-        tables_.emplace(num_entries_, tables[i]);
-    }
+    const std::vector<std::pair<bool, const RowGroupInfo *>> &tables, Loader *loader,
+    std::shared_ptr<const std::vector<RowBitmap>> row_mapping)
+    : tables_(tables), loader_(loader), row_mapping_(std::move(row_mapping)) {
+    offsets_.reserve(tables.size() + 1);
+    for (auto const &selection : *row_mapping_) {
+        offsets_.emplace_back(offsets_.back() + selection.size());
+    }
+    num_entries_ = offsets_.back();
 }
 
 Loader::Loader(const std::string &dir) : Loader(std::vector<std::string>{dir}) {}
@@ -249,7 +288,7 @@ Loader::Loader(const std::vector<std::string> &dirs) {
     // compute stats. this should be very fast
     compute_stats();
     init_cache();
-    compute_event_id_index();
+    build_index();
 }
 
 Loader::Loader(const std::vector<FileSystemInfo> &infos) {
@@ -260,58 +299,15 @@ Loader::Loader(const std::vector<FileSystemInfo> &infos) {
     // compute stats. this should be very fast
     compute_stats();
     init_cache();
-    compute_event_id_index();
-}
-
-bool contains_value(const std::shared_ptr<parquet::Statistics> &stats, uint64_t value) {
-    auto typed = std::reinterpret_pointer_cast<parquet::TypedStatistics<arrow::UInt64Type>>(stats);
-    auto min = typed->min();
-    auto max = typed->max();
-    return max >= value && min <= value;
-}
-
-bool contains_value(const std::shared_ptr<parquet::Statistics> &stats, uint64_t min_value,
-                    uint64_t max_value) {
-    auto typed = std::reinterpret_pointer_cast<parquet::TypedStatistics<arrow::UInt64Type>>(stats);
-    auto min = typed->min();
-    auto max = typed->max();
-    return min <= max_value && min_value <= max;
-}
-
-bool contains_value(const std::shared_ptr<parquet::Statistics> &min_stats,
-                    const std::shared_ptr<parquet::Statistics> &max_stats, uint64_t min_value,
-                    uint64_t max_value) {
-    auto typed_min =
-        std::reinterpret_pointer_cast<parquet::TypedStatistics<arrow::UInt64Type>>(min_stats);
-    auto typed_max =
-        std::reinterpret_pointer_cast<parquet::TypedStatistics<arrow::UInt64Type>>(max_stats);
-    auto min = typed_min->min();
-    auto max = typed_max->max();
-
-    return min <= max_value && min_value <= max;
+    build_index();
 }
 
 std::shared_ptr<Transaction> Loader::get_transaction(uint64_t id) {
-    // find out ids
-    std::vector<std::pair<const FileInfo *, std::vector<uint64_t>>> files;
-    for (auto const *file : transactions_) {
-        auto stats = file_metadata_.at(file);
-        auto id_stats = stats.at("id");
-        std::vector<uint64_t> chunks;
-        for (uint64_t i = 0; i < id_stats.size(); i++) {
-            if (contains_value(id_stats[i], id)) {
-                // we assume that most of the ids are stored together, so this method
-                // should be very fast actually
-                chunks.emplace_back(i);
-            }
-        }
-        files.emplace_back(std::make_pair(file, chunks));
-    }
-    if (files.empty()) return nullptr;
-    auto tables = load_tables(files);
-    // we expect there is only one entry
-    for (auto const &table : tables) {
-        auto t = load_transactions(table.table);
+    // we assume that most of the ids are stored together, so there should only be one
+    // row group
+    auto row_groups = find_row_groups(FileInfo::FileType::transaction, id);
+    for (auto const *row_group : row_groups) {
+        auto t = load_transactions(row_group);
         if (t->contains(id)) {
             return t->at(id);
         }
@@ -320,27 +316,9 @@ std::shared_ptr<Transaction> Loader::get_transaction(uint64_t id) {
 }
 
 std::shared_ptr<TransactionGroup> Loader::get_transaction_group(uint64_t id) {
-    // TODO: refactor this
-    // find out ids
-    std::vector<std::pair<const FileInfo *, std::vector<uint64_t>>> files;
-    for (auto const *file : transaction_groups_) {
-        auto stats = file_metadata_.at(file);
-        auto id_stats = stats.at("id");
-        std::vector<uint64_t> chunks;
-        for (uint64_t i = 0; i < id_stats.size(); i++) {
-            if (contains_value(id_stats[i], id)) {
-                // we assume that most of the ids are stored together, so this method
-                // should be very fast actually
-                chunks.emplace_back(i);
-            }
-        }
-        files.emplace_back(std::make_pair(file, chunks));
-    }
-    if (files.empty()) return nullptr;
-    auto tables = load_tables(files);
-    // we expect there is only one entry
-    for (auto const &table : tables) {
-        auto t = load_transaction_groups(table.table);
+    auto row_groups = find_row_groups(FileInfo::FileType::transaction_group, id);
+    for (auto const *row_group : row_groups) {
+        auto t = load_transaction_groups(row_group);
         if (t->contains(id)) {
             return t->at(id);
         }
@@ -355,7 +333,7 @@ std::vector<std::shared_ptr<TransactionBatch>> Loader::get_transactions(uint64_t
     std::vector<std::shared_ptr<TransactionBatch>> result;
     result.reserve(tables.size());
     for (auto const &load_result : tables) {
-        auto batch = load_transactions(load_result.table);
+        auto batch = load_transactions(load_result.row_group);
         batch->set_name(load_result.name);
         result.emplace_back(std::move(batch));
     }
@@ -378,7 +356,7 @@ std::shared_ptr<TransactionBatch> Loader::get_transactions(const std::string &na
     auto tables = load_transaction_table(name, min_time, max_time);
     std::shared_ptr<TransactionBatch> result;
     for (auto const &load_result : tables) {
-        auto batch = load_transactions(load_result.table);
+        auto batch = load_transactions(load_result.row_group);
         if (!result) {
             result = batch;
         } else {
@@ -394,7 +372,7 @@ std::shared_ptr<TransactionGroupBatch> Loader::get_transaction_groups(const std:
     auto tables = load_transaction_group_table(name, min_time, max_time);
     std::shared_ptr<TransactionGroupBatch> result;
     for (auto const &load_result : tables) {
-        auto batch = load_transaction_groups(load_result.table);
+        auto batch = load_transaction_groups(load_result.row_group);
         if (!result) {
             result = batch;
         } else {
@@ -407,27 +385,9 @@ std::shared_ptr<TransactionGroupBatch> Loader::get_transaction_groups(const std:
 std::shared_ptr<TransactionBatch> Loader::get_transactions(
     const std::shared_ptr<Transaction> &transaction) {
     auto const id = transaction->id();
-    std::vector<std::pair<const FileInfo *, std::vector<uint64_t>>> files;
-    for (auto const *file : transactions_) {
-        if (file->type == FileInfo::FileType::transaction) {
-            auto stats = file_metadata_.at(file);
-            auto id_stats = stats.at("id");
-            std::vector<uint64_t> chunks;
-            for (uint64_t i = 0; i < id_stats.size(); i++) {
-                if (contains_value(id_stats[i], id)) {
-                    // we assume that most of the ids are stored together, so this method
-                    // should be very fast actually
-                    chunks.emplace_back(i);
-                }
-            }
-            files.emplace_back(std::make_pair(file, chunks));
-        }
-    }
-    if (files.empty()) return nullptr;
-    auto tables = load_tables(files);
-    // we expect there is only one entry
-    for (auto const &table : tables) {
-        auto t = load_transactions(table.table);
+    auto row_groups = find_row_groups(FileInfo::FileType::transaction, id);
+    for (auto const *row_group : row_groups) {
+        auto t = load_transactions(row_group);
         if (t->contains(id)) {
             return t;
         }
@@ -440,7 +400,7 @@ std::vector<std::shared_ptr<EventBatch>> Loader::get_events(uint64_t min_time, u
     std::vector<std::shared_ptr<EventBatch>> result;
     result.reserve(tables.size());
     for (auto const &load_result : tables) {
-        auto batch = load_events(load_result.table);
+        auto batch = load_events(load_result.row_group);
         batch->set_name(load_result.name);
         result.emplace_back(std::move(batch));
     }
@@ -449,24 +409,10 @@ std::vector<std::shared_ptr<EventBatch>> Loader::get_events(uint64_t min_time, u
 
 std::shared_ptr<EventBatch> Loader::get_events(const std::string &name, uint64_t min_time,
                                                uint64_t max_time) {
-    std::vector<std::pair<const FileInfo *, std::vector<uint64_t>>> files;
-    for (auto const &file : events_) {
-        if (file->name != name) {
-            continue;
-        }
-        auto stats = file_metadata_.at(file);
-        auto pair = std::make_pair(file, std::vector<uint64_t>{});
-        for (uint64_t idx = 0; idx < file_metadata_.size(file); idx++) {
-            if (contains_time(file, idx, min_time, max_time)) {
-                pair.second.emplace_back(idx);
-            }
-        }
-        files.emplace_back(pair);
-    }
-    auto tables = load_tables(files);
+    auto tables = load_batch_table(FileInfo::FileType::event, name, min_time, max_time);
     std::shared_ptr<EventBatch> result;
     for (auto const &load_result : tables) {
-        auto batch = load_events(load_result.table);
+        auto batch = load_events(load_result.row_group);
         if (!result) {
             result = batch;
             result->set_name(load_result.name);
@@ -485,35 +431,100 @@ std::shared_ptr<EventBatch> Loader::get_events(const std::string &name, uint64_t
     return result;
 }
 
-std::shared_ptr<EventBatch> Loader::get_events(const Transaction &transaction) {
+std::shared_ptr<EventBatch> Loader::get_events(const Transaction &transaction, CacheHint hint) {
+    auto events = resolve_events(transaction.events(), hint);
     auto result = std::make_shared<EventBatch>();
-    result->resize(transaction.events().size(), nullptr);
-    if (event_id_index_.empty()) return result;
-
-    for (auto i = 0u; i < result->size(); i++) {
-        auto const id = transaction.events()[i];
-        // need to search for the correct able
-        auto iter = event_id_index_.lower_bound(id);
-        if (iter == event_id_index_.end()) iter--;
-
-        while (iter != event_id_index_.end()) {
-            auto temp = iter;
-            auto const &target_iter = iter->first > id ? --temp : iter;
-            // we expect this loop only run once for a well-formed table
-            auto const *table = tables_.at(target_iter->second).get();
-            auto const &events = load_events(table);
-            auto *e = events->get_event(id);
-            if (e) {
-                (*result)[i] = e->shared_from_this();
-                break;
-            }
-            iter++;
+    result->reserve(events.size());
+    for (auto &e : events) {
+        result->emplace_back(std::move(e));
+    }
+    return result;
+}
+
+std::vector<std::shared_ptr<EventBatch>> Loader::get_events(
+    const std::vector<std::shared_ptr<Transaction>> &transactions, CacheHint hint) {
+    // resolve everything at once so that shared row groups are only fetched once
+    std::vector<uint64_t> ids;
+    uint64_t num_ids = 0;
+    for (auto const &t : transactions) {
+        if (t) num_ids += t->events().size();
+    }
+    ids.reserve(num_ids);
+    for (auto const &t : transactions) {
+        if (t) ids.insert(ids.end(), t->events().begin(), t->events().end());
+    }
+    auto events = resolve_events(ids, hint);
+
+    std::vector<std::shared_ptr<EventBatch>> result;
+    result.reserve(transactions.size());
+    uint64_t pos = 0;
+    for (auto const &t : transactions) {
+        auto batch = std::make_shared<EventBatch>();
+        auto size = t ? t->events().size() : 0;
+        batch->reserve(size);
+        for (uint64_t i = 0; i < size; i++) {
+            batch->emplace_back(std::move(events[pos++]));
         }
+        result.emplace_back(std::move(batch));
+    }
+    return result;
+}
+
+std::vector<std::shared_ptr<Event>> Loader::resolve_events(const std::vector<uint64_t> &ids,
+                                                           CacheHint hint) {
+    std::vector<std::shared_ptr<Event>> result(ids.size());
+    auto const *index = get_index(FileInfo::FileType::event, std::nullopt);
+    if (!index || ids.empty()) return result;
+
+    // visit the ids in sorted order so that ids stored in the same row group are
+    // resolved together
+    std::vector<uint64_t> order(ids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&ids](uint64_t a, uint64_t b) { return ids[a] < ids[b]; });
+
+    // each row group only goes through the cache once
+    std::unordered_map<const RowGroupInfo *, std::shared_ptr<EventBatch>> batches;
+    auto get_event = [&batches, hint, this](const RowGroupInfo *row_group, uint64_t id) {
+        auto it = batches.find(row_group);
+        if (it == batches.end()) {
+            it = batches.emplace(row_group, load_events(row_group, hint)).first;
+        }
+        return it->second->get_event(id);
+    };
+
+    const RowGroupInfo *last = nullptr;
+    for (auto const i : order) {
+        auto const id = ids[i];
+        Event *e = nullptr;
+        // ids from different event names interleave, so the id ranges of row groups overlap.
+        // try the row group that resolved the previous id first
+        if (last && last->contains_id(id)) e = get_event(last, id);
+        if (!e) {
+            index->id.query(id, id, [&](const RowGroupInfo *row_group) {
+                if (e || row_group == last) return;
+                e = get_event(row_group, id);
+                if (e) last = row_group;
+            });
+        }
+        if (e) result[i] = e->shared_from_this();
     }
 
     return result;
 }
 
+std::vector<std::shared_ptr<ColumnarEventBatch>> Loader::get_columnar_events(uint64_t min_time,
+                                                                             uint64_t max_time) {
+    auto tables = load_events_table(min_time, max_time);
+    return load_columnar_events(tables);
+}
+
+std::vector<std::shared_ptr<ColumnarEventBatch>> Loader::get_columnar_events(
+    const std::string &name, uint64_t min_time, uint64_t max_time) {
+    auto tables = load_batch_table(FileInfo::FileType::event, name, min_time, max_time);
+    return load_columnar_events(tables);
+}
+
 std::shared_ptr<TransactionStream> Loader::get_transaction_stream(const std::string &name) {
     // all of them
     return get_transaction_stream(name, 0, std::numeric_limits<uint64_t>::max());
@@ -522,25 +533,15 @@ std::shared_ptr<TransactionStream> Loader::get_transaction_stream(const std::str
 std::shared_ptr<TransactionStream> Loader::get_transaction_stream(const std::string &name,
                                                                   uint64_t start_time,
                                                                   uint64_t end_time) {
-    // need to find files
-    std::unordered_set<const FileInfo *> files;
-    for (auto const &file : files_) {
-        if (file->name == name && (file->type == FileInfo::FileType::transaction ||
-                                   file->type == FileInfo::FileType::transaction_group)) {
-            files.emplace(file.get());
-        }
-    }
-    if (files.empty()) return nullptr;
     // need to gather all the tables given the info
-    std::vector<std::pair<bool, const arrow::Table *>> tables;
-    for (auto const &[entry, table] : tables_) {
-        auto const &[f, c_id] = entry;
-        // need to make sure we have that range
-        if (!contains_time(f, c_id, start_time, end_time)) continue;
-        if (files.find(f) != files.end()) {
-            tables.emplace_back(
-                std::make_pair(f->type == FileInfo::FileType::transaction_group, table.get()));
-        }
+    std::vector<std::pair<bool, const RowGroupInfo *>> tables;
+    for (auto type : {FileInfo::FileType::transaction, FileInfo::FileType::transaction_group}) {
+        auto const *index = get_index(type, name);
+        if (!index) continue;
+        auto is_group = type == FileInfo::FileType::transaction_group;
+        index->time.query(start_time, end_time, [is_group, &tables](const RowGroupInfo *table) {
+            tables.emplace_back(std::make_pair(is_group, table));
+        });
     }
 
     if (!tables.empty()) {
@@ -559,14 +560,16 @@ std::shared_ptr<TransactionStream> Loader::get_transaction_stream(const std::str
         // compute the in memory size
         // we don't store it since it's unnecessary for normal use
         // we don't expect print_files will be called often
+        std::shared_ptr<arrow::Schema> schema;
+        {
+            std::lock_guard guard(file->reader_mutex);
+            schema = file->schema;
+        }
         uint64_t total_size = 0;
-        uint64_t num_chunks = 0;
-        for (auto const &[info, table] : tables_) {
-            if (info.first == file.get()) {
-                total_size += compute_table_size_in_memory(table);
-                num_chunks++;
-            }
+        for (auto const *row_group : file->row_groups) {
+            total_size += compute_table_size_in_memory(schema, row_group->num_rows);
         }
+        auto num_chunks = file->row_groups.size();
         std::cout << '\t' << "Num. of Chunks: " << num_chunks << std::endl;
         std::cout << '\t' << "Estimated size in memory: " << total_size << std::endl;
     }
@@ -574,39 +577,27 @@ std::shared_ptr<TransactionStream> Loader::get_transaction_stream(const std::str
 
 void Loader::preload() {
     // preload until the cache is full
-    // use thread pool implementation
     // maximize the load speed
-    auto pool = ThreadPool(std::thread::hardware_concurrency());
-    std::vector<std::future<void>> results;
-    for (auto const &iter : tables_) {
-        auto func = [iter, this]() {
-            auto const &[file_info, table] = iter;
-            auto const &[file, blk] = file_info;
-            switch (file->type) {
-                case FileInfo::FileType::event: {
-                    load_events(table.get());
-                    break;
-                }
-                case FileInfo::FileType::transaction: {
-                    load_transactions(table.get());
-                    break;
-                }
-                case FileInfo::FileType::transaction_group: {
-                    load_transaction_groups(table.get());
-                    break;
-                }
+    std::vector<const RowGroupInfo *> row_groups;
+    row_groups.reserve(tables_.size());
+    for (auto const &iter : tables_) row_groups.emplace_back(iter.second.get());
+    Executor::global().parallel_for(0, row_groups.size(), [&row_groups, this](uint64_t i) {
+        auto const *row_group = row_groups[i];
+        switch (row_group->file->type) {
+            case FileInfo::FileType::event: {
+                load_events(row_group);
+                break;
             }
-        };
-        auto entry = pool.enqueue(func);
-        results.emplace_back(std::move(entry));
-    }
-    for (auto &&r : results) {
-        r.get();
-    }
-    // only if all the tables are in memory
-    uint64_t num_cache_entry =
-        event_cache_->size() + transaction_cache_->size() + transaction_group_cache_->size();
-    preloaded_ = num_cache_entry == tables_.size();
+            case FileInfo::FileType::transaction: {
+                load_transactions(row_group);
+                break;
+            }
+            case FileInfo::FileType::transaction_group: {
+                load_transaction_groups(row_group);
+                break;
+            }
+        }
+    });
 }
 
 void Loader::open_dir(const FileSystemInfo &info) {
@@ -615,7 +606,19 @@ void Loader::open_dir(const FileSystemInfo &info) {
     auto fs = load_fs(info);
     if (!fs) return;
 
-    // load the checkpoint files
+    // the manifest has everything we need for planning, so no footer is read here
+    std::unordered_set<std::string> manifest_files;
+    auto num_files = files_.size();
+    auto manifest = read_file(fs, Serializer::get_manifest_filename(info.path));
+    if (manifest && load_manifest(*manifest, info.path, fs)) {
+        // only the files of this directory
+        for (auto i = num_files; i < files_.size(); i++) {
+            manifest_files.emplace(fs::path(files_[i]->filename).lexically_normal());
+        }
+    }
+
+    // a serializer appending to an older directory only lists its own files in the
+    // manifest, so the checkpoint files are loaded as well
     auto checkpoint_filename = Serializer::get_checkpoint_filename(info.path);
     auto fs_res = fs->OpenInputFile(checkpoint_filename);
     if (!fs_res.ok()) return;
@@ -623,36 +626,171 @@ void Loader::open_dir(const FileSystemInfo &info) {
     // load into string
     auto files = load_checkpoint_info(*fs_res);
     // multi-thread loading
-    std::vector<std::thread> threads;
-    threads.reserve(files.size());
-    for (auto const &filename : files) {
-        auto json_filename = fmt::format("{0}/{1}", info.path, filename);
-        threads.emplace_back(
-            std::thread([json_filename, fs, this]() { load_json(json_filename, fs); }));
+    Executor::global().parallel_for(
+        0, files.size(), [&files, &info, &fs, &manifest_files, this](uint64_t i) {
+            auto json_filename = fmt::format("{0}/{1}", info.path, files[i]);
+            load_json(json_filename, fs, manifest_files);
+        });
+}
+
+std::optional<FileInfo::FileType> get_file_type(const std::string &type) {
+    if (type == "event")
+        return FileInfo::FileType::event;
+    else if (type == "transaction")
+        return FileInfo::FileType::transaction;
+    else if (type == "transaction-group")
+        return FileInfo::FileType::transaction_group;
+    else
+        return std::nullopt;
+}
+
+std::shared_ptr<arrow::DataType> get_data_type(const std::string &type) {
+    // these are the only types the serializer produces
+    static const std::vector<std::shared_ptr<arrow::DataType>> types = {
+        arrow::boolean(),
+        arrow::uint8(),
+        arrow::uint16(),
+        arrow::uint32(),
+        arrow::uint64(),
+        arrow::utf8(),
+        arrow::list(arrow::uint64()),
+        arrow::list(arrow::boolean())};
+    for (auto const &t : types) {
+        if (t->ToString() == type) return t;
     }
+    return nullptr;
+}
+
+std::shared_ptr<arrow::Schema> load_manifest_schema(const rapidjson::Value &value) {
+    if (!value.IsObject() || value.MemberCount() == 0) return nullptr;
+    std::vector<std::shared_ptr<arrow::Field>> fields;
+    fields.reserve(value.MemberCount());
+    for (auto const &member : value.GetObject()) {
+        if (!member.value.IsString()) return nullptr;
+        auto type = get_data_type(member.value.GetString());
+        // unknown types will be read from the footer instead
+        if (!type) return nullptr;
+        fields.emplace_back(arrow::field(member.name.GetString(), type));
+    }
+    return arrow::schema(fields);
+}
+
+std::optional<std::pair<uint64_t, uint64_t>> get_range(const rapidjson::Value &value,
+                                                       const char *name) {
+    if (!value.HasMember(name)) return std::nullopt;
+    auto const &range = value[name];
+    if (!range.IsArray() || range.Size() != 2 || !range[0u].IsUint64() || !range[1u].IsUint64())
+        return std::nullopt;
+    return std::make_pair(range[0u].GetUint64(), range[1u].GetUint64());
+}
+
+bool Loader::load_manifest(const std::string &content, const std::string &dir,
+                           const std::shared_ptr<arrow::fs::FileSystem> &fs) {
+    rapidjson::Document document;
+    document.Parse(content.c_str());
+    if (document.HasParseError() || !document.IsObject()) return false;
+    if (!document.HasMember("files") || !document["files"].IsArray()) return false;
+
+    for (auto const &entry : document["files"].GetArray()) {
+        if (!entry.IsObject()) continue;
+        if (!entry.HasMember("parquet") || !entry["parquet"].IsString()) continue;
+        if (!entry.HasMember("type") || !entry["type"].IsString()) continue;
+        auto file_type = get_file_type(entry["type"].GetString());
+        if (!file_type) continue;
+
+        auto parquet_file = fs::path(dir) / entry["parquet"].GetString();
+        auto info = std::make_unique<FileInfo>(*file_type, parquet_file);
+        info->fs = fs;
+        if (entry.HasMember("name") && entry["name"].IsString()) {
+            info->name = entry["name"].GetString();
+        }
+        if (entry.HasMember("size") && entry["size"].IsUint64()) {
+            info->size = entry["size"].GetUint64();
+        }
+        if (entry.HasMember("schema")) {
+            info->schema = load_manifest_schema(entry["schema"]);
+        }
+
+        std::vector<std::unique_ptr<RowGroupInfo>> row_groups;
+        bool valid = entry.HasMember("row_groups") && entry["row_groups"].IsArray();
+        if (valid) {
+            auto const &groups = entry["row_groups"].GetArray();
+            for (rapidjson::SizeType idx = 0; idx < groups.Size(); idx++) {
+                auto const &group = groups[idx];
+                if (!group.IsObject() || !group.HasMember("num_rows") ||
+                    !group["num_rows"].IsUint64()) {
+                    valid = false;
+                    break;
+                }
+                auto row_group = std::make_unique<RowGroupInfo>(info.get(), idx,
+                                                                group["num_rows"].GetUint64());
+                if (*file_type == FileInfo::FileType::event) {
+                    if (auto time = get_range(group, Event::TIME_NAME)) {
+                        std::tie(row_group->min_time, row_group->max_time) = *time;
+                    }
+                } else {
+                    auto start = get_range(group, Transaction::START_TIME_NAME);
+                    auto end = get_range(group, Transaction::END_TIME_NAME);
+                    if (start && end) {
+                        row_group->min_time = start->first;
+                        row_group->max_time = end->second;
+                    }
+                }
+                if (auto id = get_range(group, Event::ID_NAME)) {
+                    std::tie(row_group->min_id, row_group->max_id) = *id;
+                }
+                row_groups.emplace_back(std::move(row_group));
+            }
+        }
 
-    // join
-    for (auto &t : threads) {
-        t.join();
+        if (valid) {
+            for (auto &row_group : row_groups) add_row_group(info.get(), std::move(row_group));
+        } else {
+            // a partial list would hide the remaining row groups, so the statistics
+            // come from the footer instead
+            auto file_res = fs->OpenInputFile(info->filename);
+            if (!file_res.ok() || !load_footer(info.get(), *file_res)) continue;
+        }
+
+        add_file(std::move(info));
     }
+
+    return true;
+}
+
+void Loader::add_file(std::unique_ptr<FileInfo> info) {
+    std::lock_guard guard(files_mutex_);
+    switch (info->type) {
+        case FileInfo::FileType::event: {
+            events_.emplace_back(info.get());
+            break;
+        }
+        case FileInfo::FileType::transaction: {
+            transactions_.emplace_back(info.get());
+            break;
+        }
+        case FileInfo::FileType::transaction_group: {
+            transaction_groups_.emplace_back(info.get());
+            break;
+        }
+    }
+    files_.emplace_back(std::move(info));
+}
+
+void Loader::add_row_group(FileInfo *file, std::unique_ptr<RowGroupInfo> row_group) {
+    file->row_groups.emplace_back(row_group.get());
+    std::lock_guard guard(files_mutex_);
+    tables_.emplace(std::make_pair(file, row_group->row_group), std::move(row_group));
 }
 
 void Loader::load_json(const std::string &json_info,
-                       const std::shared_ptr<arrow::fs::FileSystem> &fs) {
-    auto file_res = fs->OpenInputFile(json_info);
-    if (!file_res.ok()) return;
-    auto file = *file_res;
-    // read out the entire content
-    auto size_res = file->GetSize();
-    if (!size_res.ok()) return;
-    auto file_size = *size_res;
-    auto buffer_res = file->Read(file_size);
-    if (!buffer_res.ok()) return;
-    auto buffer = *buffer_res;
-    auto content = buffer->ToString();
+                       const std::shared_ptr<arrow::fs::FileSystem> &fs,
+                       const std::unordered_set<std::string> &skip_files) {
+    auto content = read_file(fs, json_info);
+    if (!content) return;
 
     rapidjson::Document document;
-    document.Parse(content.c_str());
+    document.Parse(content->c_str());
     if (document.HasParseError()) return;
     // get indexed value
     auto opt_parquet_file = json::get_member<std::string>(document, "parquet");
@@ -661,46 +799,21 @@ void Loader::load_json(const std::string &json_info,
 
     auto opt_type = json::get_member<std::string>(document, "type");
     if (!opt_type) return;
-    auto const &type = *opt_type;
+    auto file_type = get_file_type(*opt_type);
+    if (!file_type) return;
 
     parquet_file = fs::path(json_info).parent_path() / parquet_file;
+    // already loaded from the manifest
+    if (skip_files.find(fs::path(parquet_file).lexically_normal()) != skip_files.end()) return;
     // make sure we can actually open this file
     auto table_file_res = fs->OpenInputFile(parquet_file);
     if (!table_file_res.ok()) return;
     auto table_file = *table_file_res;
-    size_res = table_file->GetSize();
+    auto size_res = table_file->GetSize();
     if (!size_res.ok()) return;
-    file_size = *size_res;
-
-    FileInfo::FileType file_type;
-    if (type == "event")
-        file_type = FileInfo::FileType::event;
-    else if (type == "transaction")
-        file_type = FileInfo::FileType::transaction;
-    else if (type == "transaction-group")
-        file_type = FileInfo::FileType::transaction_group;
-    else
-        return;
 
-    auto info = std::make_unique<FileInfo>(file_type, parquet_file);
-    {
-        std::lock_guard guard(files_mutex_);
-
-        switch (file_type) {
-            case FileInfo::FileType::event: {
-                events_.emplace_back(info.get());
-                break;
-            }
-            case FileInfo::FileType::transaction: {
-                transactions_.emplace_back(info.get());
-                break;
-            }
-            case FileInfo::FileType::transaction_group: {
-                transaction_groups_.emplace_back(info.get());
-                break;
-            }
-        }
-    }
+    auto info = std::make_unique<FileInfo>(*file_type, parquet_file);
+    info->fs = fs;
 
     // get name
     auto name_opt = json::get_member<std::string>(document, "name");
@@ -708,185 +821,207 @@ void Loader::load_json(const std::string &json_info,
         info->name = *name_opt;
     }
     // size
-    info->size = file_size;
-    // load table as well
-    // notice that we don't actually load the entire table into memory, just
-    // indices and references
-    preload_table(info.get(), table_file);
+    info->size = *size_res;
+    // there is no manifest, so the statistics have to come from the footer
+    if (!load_footer(info.get(), table_file)) return;
 
-    {
-        std::lock_guard guard(files_mutex_);
-        files_.emplace_back(std::move(info));
-    }
+    add_file(std::move(info));
+}
+
+// returns false if the column does not have usable statistics
+bool get_min_max(const std::shared_ptr<parquet::Statistics> &stats, uint64_t &min,
+                 uint64_t &max) {
+    if (!stats || !stats->HasMinMax()) return false;
+    auto typed = std::reinterpret_pointer_cast<parquet::TypedStatistics<arrow::UInt64Type>>(stats);
+    min = typed->min();
+    max = typed->max();
+    return true;
 }
 
-bool Loader::preload_table(const FileInfo *file,
-                           const std::shared_ptr<arrow::io::RandomAccessFile> &f) {
+bool Loader::load_footer(FileInfo *file,
+                         const std::shared_ptr<arrow::io::RandomAccessFile> &f) {
     auto *pool = arrow::default_memory_pool();
     std::unique_ptr<parquet::arrow::FileReader> file_reader;
     auto res = parquet::arrow::OpenFile(f, pool, &file_reader);
     if (!res.ok()) return false;
-    // load each chunks
-    auto num_row_groups = file_reader->num_row_groups();
-    for (int row_group_id = 0; row_group_id < num_row_groups; row_group_id++) {
-        std::shared_ptr<arrow::Table> table;
-        auto res_t = file_reader->ReadRowGroup(row_group_id, &table);
-        if (!res_t.ok()) {
-            std::cerr << "[ERROR]: " << res_t.ToString() << std::endl;
-            return false;
-        }
-        {
-            std::lock_guard guard(files_mutex_);
-            tables_.emplace(std::make_pair(file, row_group_id), table);
-        }
+    res = file_reader->GetSchema(&file->schema);
+    if (!res.ok()) {
+        std::cerr << "[ERROR]: " << res.ToString() << std::endl;
+        return false;
     }
 
-    // also load statistic
-    auto metadata = file_reader->parquet_reader()->metadata();
     // use metadata statistics
-    for (auto row_group = 0; row_group < num_row_groups; row_group++) {
-        auto group_metadata = metadata->RowGroup(row_group);
+    auto metadata = file_reader->parquet_reader()->metadata();
+    auto num_row_groups = file_reader->num_row_groups();
+    for (auto idx = 0; idx < num_row_groups; idx++) {
+        auto group_metadata = metadata->RowGroup(idx);
         auto num_column = group_metadata->num_columns();
         auto const *schema = group_metadata->schema();
+        auto num_rows = static_cast<uint64_t>(group_metadata->num_rows());
 
+        auto row_group = std::make_unique<RowGroupInfo>(file, idx, num_rows);
+        std::optional<uint64_t> start_time, end_time;
         for (auto column_idx = 0; column_idx < num_column; column_idx++) {
             auto column_name = schema->Column(column_idx)->name();
-            auto column_meta = group_metadata->ColumnChunk(column_idx);
-            auto stats = column_meta->statistics();
-            {
-                std::lock_guard guard(files_mutex_);
-                file_metadata_[file][column_name].emplace_back(stats);
+            auto stats = group_metadata->ColumnChunk(column_idx)->statistics();
+            uint64_t min, max;
+            if (!get_min_max(stats, min, max)) continue;
+            if (column_name == Event::TIME_NAME) {
+                row_group->min_time = min;
+                row_group->max_time = max;
+            } else if (column_name == Event::ID_NAME) {
+                row_group->min_id = min;
+                row_group->max_id = max;
+            } else if (column_name == Transaction::START_TIME_NAME) {
+                start_time = min;
+            } else if (column_name == Transaction::END_TIME_NAME) {
+                end_time = max;
             }
         }
+        if (start_time && end_time) {
+            row_group->min_time = *start_time;
+            row_group->max_time = *end_time;
+        }
+        add_row_group(file, std::move(row_group));
     }
 
+    // keep the reader around so that we don't have to parse the footer again
+    file->reader = std::move(file_reader);
+
     return true;
 }
 
-std::vector<LoaderResult> Loader::load_tables(
-    const std::vector<std::pair<const FileInfo *, std::vector<uint64_t>>> &files) {
-    std::vector<LoaderResult> result;
-    result.reserve(files.size());
-    for (auto const &[file, groups] : files) {
-        for (auto const &group_id : groups) {
-            auto const *entry = tables_.at(std::make_pair(file, group_id)).get();
-            result.emplace_back(LoaderResult{entry, file->name});
+bool Loader::open_reader(const FileInfo *file) {
+    if (file->reader) return true;
+    if (!file->fs) return false;
+    auto file_res = file->fs->OpenInputFile(file->filename);
+    if (!file_res.ok()) {
+        std::cerr << "[ERROR]: " << file_res.status().ToString() << std::endl;
+        return false;
+    }
+    std::unique_ptr<parquet::arrow::FileReader> file_reader;
+    auto res = parquet::arrow::OpenFile(*file_res, arrow::default_memory_pool(), &file_reader);
+    if (!res.ok()) {
+        std::cerr << "[ERROR]: " << res.ToString() << std::endl;
+        return false;
+    }
+    if (!file->schema) {
+        res = file_reader->GetSchema(&file->schema);
+        if (!res.ok()) {
+            std::cerr << "[ERROR]: " << res.ToString() << std::endl;
+            return false;
         }
     }
-
-    return result;
+    file->reader = std::move(file_reader);
+    return true;
 }
 
-std::shared_ptr<EventBatch> Loader::load_events(const arrow::Table *table) {
-    // if everything is preloaded, go ahead and directly return the values
-    if (preloaded_) {
-        return event_cache_->get(table);
+std::shared_ptr<arrow::Table> Loader::load_table(const RowGroupInfo *row_group) {
+    auto const *file = row_group->file;
+    std::shared_ptr<arrow::Table> table;
+    arrow::Status res;
+    {
+        std::lock_guard guard(file->reader_mutex);
+        // the footer is only parsed once we actually need the data
+        if (!open_reader(file)) return nullptr;
+        res = file->reader->ReadRowGroup(static_cast<int>(row_group->row_group), &table);
     }
-    // we need to be very careful about locking and unlocking and also achieve high-performance
-    event_cache_mutex_.lock();
-    if (!event_cache_->exists(table)) {
-        event_cache_mutex_.unlock();
+    if (!res.ok()) {
+        std::cerr << "[ERROR]: " << res.ToString() << std::endl;
+        return nullptr;
+    }
+    return table;
+}
 
-        // time consuming section
-        std::shared_ptr<EventBatch> events = EventBatch::deserialize(table);
-        events->build_id_index();
+std::shared_ptr<EventBatch> Loader::load_events(const RowGroupInfo *row_group, CacheHint hint) {
+    // only one thread decodes a row group, the others wait for its result
+    auto events = event_cache_->get_or_load(
+        row_group, [row_group, this]() -> EventCache::LoadResult {
+            // time consuming section
+            auto table = load_table(row_group);
+            if (!table) return std::nullopt;
+            std::shared_ptr<EventBatch> batch = EventBatch::deserialize(table.get());
+            batch->build_id_index();
+            return std::make_pair(batch, batch->memory_size());
+        },
+        hint);
+    return events ? *events : std::make_shared<EventBatch>();
+}
 
-        // put it into cache
-        event_cache_mutex_.lock();
-        event_cache_->put(table, events);
-        event_cache_mutex_.unlock();
-        return events;
-    } else {
-        auto r = event_cache_->get(table);
-        event_cache_mutex_.unlock();
-        return r;
+std::vector<std::shared_ptr<ColumnarEventBatch>> Loader::load_columnar_events(
+    const std::vector<LoaderResult> &tables) {
+    std::vector<std::shared_ptr<ColumnarEventBatch>> result;
+    result.reserve(tables.size());
+    for (auto const &load_result : tables) {
+        auto table = load_table(load_result.row_group);
+        if (!table) continue;
+        std::shared_ptr<ColumnarEventBatch> batch = ColumnarEventBatch::deserialize(table);
+        if (!batch) continue;
+        batch->set_name(load_result.name);
+        result.emplace_back(std::move(batch));
     }
+    return result;
 }
 
-std::shared_ptr<TransactionBatch> Loader::load_transactions(const arrow::Table *table) {
+std::shared_ptr<TransactionBatch> Loader::load_transactions(const RowGroupInfo *row_group,
+                                                            CacheHint hint) {
     // similar logic to transaction cache as the load events
-    transaction_cache_mutex_.lock();
-    if (!transaction_cache_->exists(table)) {
-        transaction_cache_mutex_.unlock();
-
-        // time consuming section
-        std::shared_ptr<TransactionBatch> transactions = TransactionBatch::deserialize(table);
-        transactions->build_id_index();
-
-        // put it into the cache
-        transaction_cache_mutex_.lock();
-        transaction_cache_->put(table, transactions);
-        transaction_cache_mutex_.unlock();
-
-        return transactions;
-    } else {
-        auto r = transaction_cache_->get(table);
-        transaction_cache_mutex_.unlock();
-
-        return r;
-    }
+    auto transactions = transaction_cache_->get_or_load(
+        row_group, [row_group, this]() -> TransactionCache::LoadResult {
+            auto table = load_table(row_group);
+            if (!table) return std::nullopt;
+            std::shared_ptr<TransactionBatch> batch = TransactionBatch::deserialize(table.get());
+            batch->build_id_index();
+            return std::make_pair(batch, batch->memory_size());
+        },
+        hint);
+    return transactions ? *transactions : std::make_shared<TransactionBatch>();
 }
 
-std::shared_ptr<TransactionGroupBatch> Loader::load_transaction_groups(const arrow::Table *table) {
+std::shared_ptr<TransactionGroupBatch> Loader::load_transaction_groups(
+    const RowGroupInfo *row_group, CacheHint hint) {
     // same logic
-    transaction_group_cache_mutex_.lock();
-    if (!transaction_group_cache_->exists(table)) {
-        transaction_group_cache_mutex_.unlock();
-
-        // time consuming section
-        std::shared_ptr<TransactionGroupBatch> group = TransactionGroupBatch::deserialize(table);
-        group->build_index();
-
-        transaction_group_cache_mutex_.lock();
-        transaction_group_cache_->put(table, group);
-        transaction_group_cache_mutex_.unlock();
-
-        return group;
-    } else {
-        auto r = transaction_group_cache_->get(table);
-        transaction_group_cache_mutex_.unlock();
-
-        return r;
-    }
+    auto groups = transaction_group_cache_->get_or_load(
+        row_group, [row_group, this]() -> TransactionGroupCache::LoadResult {
+            auto table = load_table(row_group);
+            if (!table) return std::nullopt;
+            std::shared_ptr<TransactionGroupBatch> batch =
+                TransactionGroupBatch::deserialize(table.get());
+            batch->build_index();
+            return std::make_pair(batch, batch->memory_size());
+        },
+        hint);
+    return groups ? *groups : std::make_shared<TransactionGroupBatch>();
 }
 
 void Loader::compute_stats() {
     std::unordered_set<const FileInfo *> seen_files;
-    for (auto const &[info, table] : tables_) {
-        auto const &[file, blk_id] = info;
+    for (auto const &[info, row_group] : tables_) {
+        auto const *file = info.first;
+        auto const num_rows = row_group->num_rows;
+        auto const table_size = compute_table_size_in_memory(file->schema, num_rows);
         switch (file->type) {
             case FileInfo::FileType::event: {
                 stats_.num_event_files++;
-                stats_.num_events += table->num_rows();
-                // need to load the column stats
-
-                auto const &stats = file_metadata_.at(file).at("time")[blk_id];
-                auto typed =
-                    std::reinterpret_pointer_cast<parquet::TypedStatistics<arrow::UInt64Type>>(
-                        stats);
-                auto min = typed->min();
-                auto max = typed->max();
-
-                if (min < stats_.min_event_time) {
-                    stats_.min_event_time = min;
+                stats_.num_events += num_rows;
+                // empty row groups don't have a time range
+                if (num_rows > 0) {
+                    stats_.min_event_time = std::min(stats_.min_event_time, row_group->min_time);
+                    stats_.max_event_time = std::max(stats_.max_event_time, row_group->max_time);
                 }
-
-                if (max > stats_.max_event_time) {
-                    stats_.max_event_time = max;
-                }
-                stats_.average_event_chunk_size += compute_table_size_in_memory(table);
+                stats_.average_event_chunk_size += table_size;
                 break;
             }
             case FileInfo::FileType::transaction: {
                 stats_.num_transaction_files++;
-                stats_.num_transactions += table->num_rows();
-                stats_.average_transaction_chunk_size += compute_table_size_in_memory(table);
+                stats_.num_transactions += num_rows;
+                stats_.average_transaction_chunk_size += table_size;
                 break;
             }
             case FileInfo::FileType::transaction_group: {
                 stats_.num_transaction_group_files++;
-                stats_.num_transaction_groups += table->num_rows();
-                stats_.average_transaction_group_chunk_size += compute_table_size_in_memory(table);
+                stats_.num_transaction_groups += num_rows;
+                stats_.average_transaction_group_chunk_size += table_size;
                 break;
             }
         }
@@ -910,6 +1045,14 @@ void Loader::stream(bool stream_transactions) {
     stream(MessageBus::default_bus(), stream_transactions);
 }
 
+void Loader::stream(MessageBus *bus, bool stream_transactions) {
+    StreamOptions options;
+    options.stream_transactions = stream_transactions;
+    stream(bus, options);
+}
+
+void Loader::stream(const StreamOptions &options) { stream(MessageBus::default_bus(), options); }
+
 BatchSchema Loader::get_event_schema(const std::string &name) {
     // we put some good faith that the files with the same name will be
     // consistent
@@ -922,8 +1065,13 @@ BatchSchema Loader::get_event_schema(const std::string &name) {
         }
     }
     if (!file_) return result;
-    auto const &table = tables_.at(std::make_pair(file_, 0));
-    auto const &schema = table->schema();
+    std::shared_ptr<arrow::Schema> schema;
+    {
+        std::lock_guard guard(file_->reader_mutex);
+        if (!file_->schema) open_reader(file_);
+        schema = file_->schema;
+    }
+    if (!schema) return result;
     auto const &names = schema->field_names();
     for (auto const &n : names) {
         auto field = schema->GetFieldByName(n);
@@ -969,234 +1117,276 @@ std::set<std::string> Loader::get_transaction_group_names() const {
     return get_names(files_, FileInfo::FileType::transaction_group);
 }
 
-template <typename T>
-void should_stop(const std::vector<std::shared_ptr<T>> &values,
-                 const std::vector<uint64_t> &indices, bool &stop) {
-    if (!values.empty()) {
-        for (uint64_t i = 0; i < values.size(); i++) {
-            if (indices[i] < values[i]->size()) {
-                stop = false;
-            }
-        }
+// decoded chunk that is being merged by Loader::stream. the variant index is also the priority
+// among items with the same time, i.e. events go out before transactions
+using StreamBatch = std::variant<std::shared_ptr<EventBatch>, std::shared_ptr<TransactionBatch>,
+                                 std::shared_ptr<TransactionGroupBatch>>;
+
+struct StreamCursor {
+    StreamBatch batch;
+    uint64_t index;
+    // time of the current item
+    uint64_t time;
+    // position of the chunk in the schedule, so that the merge is deterministic
+    uint64_t order;
+
+    bool operator>(const StreamCursor &other) const {
+        return std::make_tuple(time, batch.index(), order) >
+               std::make_tuple(other.time, other.batch.index(), other.order);
     }
+};
+
+uint64_t get_stream_time(const std::shared_ptr<Event> &event) { return event->time(); }
+uint64_t get_stream_time(const std::shared_ptr<Transaction> &transaction) {
+    return transaction->start_time();
+}
+uint64_t get_stream_time(const std::shared_ptr<TransactionGroup> &group) {
+    return group->start_time();
 }
 
-template <typename T>
-void stream_values(std::vector<std::shared_ptr<T>> &values, std::vector<uint64_t> &indices,
-                   MessageBus *bus) {
-    if (!values.empty()) {
-        uint32_t min_index = 0;
-        auto value = (*values[min_index])[indices[min_index]];
-        for (uint64_t i = 1; i < values.size(); i++) {
-            if constexpr (std::is_same<T, EventBatch>::value) {
-                if ((*values[i])[indices[i]]->time() < value->time()) {
-                    min_index = i;
-                    value = (*values[i])[indices[i]];
-                }
-            } else if constexpr (std::is_same<T, TransactionBatch>::value ||
-                                 std::is_same<T, TransactionGroupBatch>::value) {
-                if ((*values[i])[indices[i]]->start_time() < value->start_time()) {
-                    min_index = i;
-                    value = (*values[i])[indices[i]];
+// moves the cursor to the next item inside [start, end], starting from the current one.
+// returns false if the batch is exhausted
+bool update_cursor(StreamCursor &cursor, uint64_t start, uint64_t end) {
+    return std::visit(
+        [&cursor, start, end](auto const &batch) {
+            for (; cursor.index < batch->size(); cursor.index++) {
+                auto time = get_stream_time((*batch)[cursor.index]);
+                // batches are sorted by time
+                if (time > end) return false;
+                if (time >= start) {
+                    cursor.time = time;
+                    return true;
                 }
             }
-        }
-        indices[min_index]++;
-        bus->publish(values[min_index]->name(), value);
-
-        // need to be careful about the boundary
-        if (indices[min_index] >= values[min_index]->size()) {
-            // need to pop that entry
-            values.erase(values.begin() + min_index);
-            indices.erase(indices.begin() + min_index);
-        }
-    }
+            return false;
+        },
+        cursor.batch);
 }
 
-template <typename T>
-void load_values(const std::vector<LoaderResult> &load_results,
-                 std::vector<std::shared_ptr<T>> &values,
-                 const std::function<std::shared_ptr<T>(const arrow::Table *)> &load_func) {
-    for (auto const &res : load_results) {
-        auto const &table = res.table;
-
-        // load the table
-        auto event_batch = load_func(table);
-        event_batch->set_name(res.name);
-        values.emplace_back(std::move(event_batch));
-    }
+void publish_cursor(const StreamCursor &cursor, MessageBus *bus) {
+    std::visit(
+        [&cursor, bus](auto const &batch) { bus->publish(batch->name(), (*batch)[cursor.index]); },
+        cursor.batch);
 }
 
-void Loader::stream(MessageBus *bus, bool stream_transactions) {
-    // we stream out every items roughly based on the time
-    // because each table is a chunk, as long as the cache doesn't
-    // take much memory, we're good
-
-    // we load them in approximation of time, it won't be perfect but should be good
-    // enough
-
-    auto load_results = load_events_table(0, std::numeric_limits<uint64_t>::max());
-    std::vector<std::shared_ptr<EventBatch>> events;
-    std::vector<std::shared_ptr<TransactionBatch>> transactions;
-    std::vector<std::shared_ptr<TransactionGroupBatch>> transaction_groups;
-
-    // gcc failed to induce the template type
-    load_values<EventBatch>(load_results, events,
-                            [this](const arrow::Table *table) { return load_events(table); });
-
-    // decide whether to stream transactions or not
-    if (stream_transactions) {
-        load_results =
-            load_transaction_table(std::nullopt, 0, std::numeric_limits<uint64_t>::max());
-
-        load_values<TransactionBatch>(
-            load_results, transactions,
-            [this](const arrow::Table *table) { return load_transactions(table); });
-
-        // groups as well
-        load_results =
-            load_transaction_group_table(std::nullopt, 0, std::numeric_limits<uint64_t>::max());
-        load_values<TransactionGroupBatch>(
-            load_results, transaction_groups,
-            [this](const arrow::Table *table) { return load_transaction_groups(table); });
-    }
-
-    std::vector<uint64_t> event_indices;
-    event_indices.resize(events.size(), 0);
-    std::vector<uint64_t> transaction_indices;
-    transaction_indices.resize(transactions.size(), 0);
-    std::vector<uint64_t> transaction_group_indices;
-    transaction_group_indices.resize(transactions.size(), 0);
-
-    // stream out the events and transactions
+void Loader::stream(MessageBus *bus, const StreamOptions &options) {
+    // k-way merge over all the chunks. a chunk only has to be opened once the merge frontier
+    // reaches its minimum time, so the chunks are scheduled in that order and decoded ahead of
+    // the frontier on background threads
+    auto const start = options.start_time;
+    auto const end = options.end_time;
+    if (start > end) return;
+    // row groups are pruned by name and time range before anything is decoded
+    std::vector<std::pair<LoaderResult, FileInfo::FileType>> chunks;
+    auto add_chunks = [&, this](FileInfo::FileType type) {
+        auto add = [&](const std::optional<std::string> &name) {
+            for (auto const &res : load_batch_table(type, name, start, end)) {
+                chunks.emplace_back(res, type);
+            }
+        };
+        if (options.topics.empty()) {
+            add(std::nullopt);
+            return;
+        }
+        for (auto const &name : get_names(files_, type)) {
+            auto match = std::any_of(
+                options.topics.begin(), options.topics.end(), [&name](const std::string &topic) {
+                    return fnmatch(topic.c_str(), name.c_str(), FNM_EXTMATCH) == 0;
+                });
+            if (match) add(name);
+        }
+    };
+    add_chunks(FileInfo::FileType::event);
+    if (options.stream_transactions) {
+        add_chunks(FileInfo::FileType::transaction);
+        add_chunks(FileInfo::FileType::transaction_group);
+    }
+    // stable so that events stay in front of transactions with the same minimum time
+    std::stable_sort(chunks.begin(), chunks.end(), [](auto const &a, auto const &b) {
+        return a.first.row_group->min_time < b.first.row_group->min_time;
+    });
+
+    // every row group is read exactly once, so the decoded batches should not push the working
+    // set out of the caches
+    auto load_chunk = [this](const LoaderResult &res, FileInfo::FileType type) -> StreamBatch {
+        switch (type) {
+            case FileInfo::FileType::event: {
+                auto batch = load_events(res.row_group, CacheHint::scan);
+                batch->set_name(res.name);
+                return batch;
+            }
+            case FileInfo::FileType::transaction: {
+                auto batch = load_transactions(res.row_group, CacheHint::scan);
+                batch->set_name(res.name);
+                return batch;
+            }
+            case FileInfo::FileType::transaction_group: {
+                auto batch = load_transaction_groups(res.row_group, CacheHint::scan);
+                batch->set_name(res.name);
+                return batch;
+            }
+        }
+        return std::make_shared<EventBatch>();
+    };
+
+    // only a bounded number of chunks is decoded ahead of the frontier
+    auto &executor = Executor::global();
+    uint64_t const window = executor.num_threads() * 2;
+    std::deque<std::future<StreamBatch>> pending;
+    uint64_t next_chunk = 0;
+    auto schedule = [&]() {
+        while (next_chunk < chunks.size() && pending.size() < window) {
+            auto const &[res, type] = chunks[next_chunk++];
+            pending.emplace_back(executor.submit([load_chunk, res = res, type = type]() {
+                return load_chunk(res, type);
+            }));
+        }
+    };
+    schedule();
 
+    // min-heap on the time of the current item of every open chunk
+    std::vector<StreamCursor> heap;
+    auto compare = std::greater<>();
+    uint64_t opened = 0;
     while (true) {
-        bool stop = true;
-        should_stop(events, event_indices, stop);
-        should_stop(transactions, transaction_indices, stop);
-        should_stop(transaction_groups, transaction_group_indices, stop);
-
-        if (stop) break;
-
-        // stream events
-        stream_values(events, event_indices, bus);
-        stream_values(transactions, transaction_indices, bus);
-        stream_values(transaction_groups, transaction_group_indices, bus);
+        // open every chunk that may have an item before the current minimum
+        while (opened < chunks.size() &&
+               (heap.empty() || chunks[opened].first.row_group->min_time <= heap.front().time)) {
+            StreamCursor cursor{executor.get(pending.front()), 0, 0, opened++};
+            pending.pop_front();
+            schedule();
+            if (update_cursor(cursor, start, end)) {
+                heap.emplace_back(std::move(cursor));
+                std::push_heap(heap.begin(), heap.end(), compare);
+            }
+        }
+        if (heap.empty()) break;
+
+        std::pop_heap(heap.begin(), heap.end(), compare);
+        auto &cursor = heap.back();
+        publish_cursor(cursor, bus);
+        cursor.index++;
+        if (update_cursor(cursor, start, end)) {
+            std::push_heap(heap.begin(), heap.end(), compare);
+        } else {
+            heap.pop_back();
+        }
     }
 }
 
 std::vector<LoaderResult> Loader::load_events_table(uint64_t min_time, uint64_t max_time) {
-    std::vector<std::pair<const FileInfo *, std::vector<uint64_t>>> files;
-    for (auto const &file : events_) {
-        auto stats = file_metadata_.at(file);
-        auto pair = std::make_pair(file, std::vector<uint64_t>{});
-        for (uint64_t idx = 0; idx < file_metadata_.size(file); idx++) {
-            if (contains_time(file, idx, min_time, max_time)) {
-                pair.second.emplace_back(idx);
-            }
-        }
-        files.emplace_back(pair);
-    }
-    // load the tables
-    auto tables = load_tables(files);
-    return tables;
+    return load_batch_table(FileInfo::FileType::event, std::nullopt, min_time, max_time);
 }
 
 std::vector<LoaderResult> Loader::load_transaction_table(const std::optional<std::string> &name,
                                                          uint64_t min_time, uint64_t max_time) {
-    return load_batch_table(transactions_, name, min_time, max_time);
+    return load_batch_table(FileInfo::FileType::transaction, name, min_time, max_time);
 }
 
 std::vector<LoaderResult> Loader::load_transaction_group_table(
     const std::optional<std::string> &name, uint64_t min_time, uint64_t max_time) {
-    return load_batch_table(transaction_groups_, name, min_time, max_time);
+    return load_batch_table(FileInfo::FileType::transaction_group, name, min_time, max_time);
 }
 
-std::vector<LoaderResult> Loader::load_batch_table(const std::vector<const FileInfo *> &info,
+std::vector<LoaderResult> Loader::load_batch_table(FileInfo::FileType type,
                                                    const std::optional<std::string> &name,
                                                    uint64_t min_time, uint64_t max_time) {
-    std::vector<std::pair<const FileInfo *, std::vector<uint64_t>>> files;
-    for (auto const &file : info) {
-        if (name) {
-            if (file->name != name) continue;
-        }
-        auto stats = file_metadata_.at(file);
-        auto pair = std::make_pair(file, std::vector<uint64_t>{});
-        for (uint64_t idx = 0; idx < file_metadata_.size(file); idx++) {
-            if (contains_time(file, idx, min_time, max_time)) {
-                pair.second.emplace_back(idx);
-            }
-        }
-        files.emplace_back(pair);
-    }
-    // load the tables
-    auto tables = load_tables(files);
-    return tables;
-}
-
-bool Loader::contains_time(const FileInfo *file, uint64_t chunk_id, uint64_t min_time,
-                           uint64_t max_time) {
-    auto stats = file_metadata_.at(file);
-    // depends on which type of files we are dealing with
-    if (file->type == FileInfo::FileType::event) {
-        auto time_stats = stats.at("time");
-        auto const &s = time_stats[chunk_id];
-        return contains_value(s, min_time, max_time);
+    std::vector<LoaderResult> result;
+    auto const *index = get_index(type, name);
+    if (!index) return result;
+    index->time.query(min_time, max_time, [&result](const RowGroupInfo *row_group) {
+        result.emplace_back(LoaderResult{row_group, row_group->file->name});
+    });
+    return result;
+}
+
+const RowGroupIndex *Loader::get_index(FileInfo::FileType type,
+                                       const std::optional<std::string> &name) const {
+    if (name) {
+        auto it = name_index_.find(std::make_pair(type, *name));
+        return it != name_index_.end() ? &it->second : nullptr;
     } else {
-        auto max_time_stats = stats.at("end_time");
-        auto min_time_stats = stats.at("start_time");
+        auto it = type_index_.find(type);
+        return it != type_index_.end() ? &it->second : nullptr;
+    }
+}
 
-        auto const &min_s = min_time_stats[chunk_id];
-        auto const &max_s = max_time_stats[chunk_id];
-        return contains_value(min_s, max_s, min_time, max_time);
+std::vector<const RowGroupInfo *> Loader::find_row_groups(FileInfo::FileType type,
+                                                          uint64_t id) const {
+    auto const *index = get_index(type, std::nullopt);
+    if (!index) return {};
+    return index->id.query(id, id);
+}
+
+void Loader::build_index() {
+    // tables_ is keyed by (file, row group), so ties keep the row group order within a file
+    for (auto const &[entry, row_group] : tables_) {
+        auto const *file = entry.first;
+        type_index_[file->type].add(row_group.get());
+        name_index_[std::make_pair(file->type, file->name)].add(row_group.get());
     }
+    for (auto &[type, index] : type_index_) index.build();
+    for (auto &[key, index] : name_index_) index.build();
 }
 
 void Loader::init_cache() {
-    // initialize the cache based on the stats
-    // get total memory
-    auto total_mem = os::get_total_system_memory();
-    // we expect the majority of the memory will be consumed by events
-    total_mem = total_mem / 6;
-    auto mem_events = total_mem * 3;
-    auto mem_transaction = total_mem;
-    auto mem_transaction_group = total_mem;
-    auto num_events =
-        stats_.average_event_chunk_size > 0 ? mem_events / stats_.average_event_chunk_size : 16;
-    auto num_transactions = stats_.average_transaction_chunk_size > 0
-                                ? mem_transaction / stats_.average_transaction_chunk_size
-                                : 16;
-    auto num_transaction_groups =
-        stats_.average_transaction_group_chunk_size > 0
-            ? mem_transaction_group / stats_.average_transaction_group_chunk_size
-            : 16;
-    event_cache_ =
-        std::make_unique<lru_cache<const arrow::Table *, std::shared_ptr<EventBatch>>>(num_events);
-    transaction_cache_ =
-        std::make_unique<lru_cache<const arrow::Table *, std::shared_ptr<TransactionBatch>>>(
-            num_transactions);
-    transaction_group_cache_ =
-        std::make_unique<lru_cache<const arrow::Table *, std::shared_ptr<TransactionGroupBatch>>>(
-            num_transaction_groups);
-}
-
-void Loader::compute_event_id_index() {
-    for (auto const *file : events_) {
-        auto stats = file_metadata_.at(file);
-        auto id_stats = stats.at("id");
-        for (uint64_t chunk_id = 0; chunk_id < id_stats.size(); chunk_id++) {
-            auto typed = std::reinterpret_pointer_cast<parquet::TypedStatistics<arrow::UInt64Type>>(
-                id_stats[chunk_id]);
-            auto min = typed->min();
-            event_id_index_.emplace(min, std::make_pair(file, chunk_id));
-        }
+    // all three caches share one budget and evict by the actual size of the decoded batches
+    auto budget = std::make_shared<MemoryBudget>(os::get_total_system_memory() / 2);
+    // 2Q so that one-off range queries and streams don't evict the batches used by point queries
+    auto constexpr policy = CachePolicy::two_queue;
+    event_cache_ = std::make_unique<EventCache>(budget, EventCache::default_num_shards, policy);
+    transaction_cache_ = std::make_unique<TransactionCache>(
+        budget, TransactionCache::default_num_shards, policy);
+    transaction_group_cache_ = std::make_unique<TransactionGroupCache>(
+        budget, TransactionGroupCache::default_num_shards, policy);
+}
+
+void Loader::set_cache_budget(uint64_t bytes) { event_cache_->budget()->set_capacity(bytes); }
+
+uint64_t Loader::cache_budget() const { return event_cache_->budget()->capacity(); }
+
+CacheStats Loader::cache_stats(FileInfo::FileType type) const {
+    switch (type) {
+        case FileInfo::FileType::event:
+            return event_cache_->stats();
+        case FileInfo::FileType::transaction:
+            return transaction_cache_->stats();
+        case FileInfo::FileType::transaction_group:
+            return transaction_group_cache_->stats();
+    }
+    return {};
+}
+
+void Loader::set_cache_policy(FileInfo::FileType type, CachePolicy policy) {
+    switch (type) {
+        case FileInfo::FileType::event:
+            event_cache_->set_policy(policy);
+            break;
+        case FileInfo::FileType::transaction:
+            transaction_cache_->set_policy(policy);
+            break;
+        case FileInfo::FileType::transaction_group:
+            transaction_group_cache_->set_policy(policy);
+            break;
     }
 }
 
-uint64_t Loader::compute_table_size_in_memory(const std::shared_ptr<arrow::Table> &table) {
+CachePolicy Loader::cache_policy(FileInfo::FileType type) const {
+    switch (type) {
+        case FileInfo::FileType::event:
+            return event_cache_->policy();
+        case FileInfo::FileType::transaction:
+            return transaction_cache_->policy();
+        case FileInfo::FileType::transaction_group:
+            return transaction_group_cache_->policy();
+    }
+    return CachePolicy::lru;
+}
+
+uint64_t Loader::compute_table_size_in_memory(const std::shared_ptr<arrow::Schema> &schema,
+                                              uint64_t num_rows) {
     // this is just estimate how much memory it will occupy the memory
-    auto const schema = table->schema();
-    uint64_t num_row = table->num_rows();
+    if (!schema) return 0;
     uint64_t row_size = 0;
     auto const &names = schema->field_names();
     for (auto const &name : names) {
@@ -1221,7 +1411,7 @@ uint64_t Loader::compute_table_size_in_memory(const std::shared_ptr<arrow::Table
     // we also consider other data structures the batch uses
     row_size +=
         sizeof(uint64_t) + sizeof(void *) + sizeof(std::unordered_map<std::string, AttributeValue>);
-    auto total = row_size * num_row;
+    auto total = row_size * num_rows;
     total += sizeof(std::unordered_map<uint64_t, void *>);
     return total;
 }
@@ -1,11 +1,15 @@
 #ifndef HERMES_LOADER_HH
 #define HERMES_LOADER_HH
 
+#include <limits>
 #include <mutex>
 #include <set>
+#include <unordered_set>
 
 #include "arrow.hh"
+#include "bitmap.hh"
 #include "cache.hh"
+#include "interval.hh"
 #include "transaction.hh"
 
 namespace arrow {
@@ -19,11 +23,14 @@ class RandomAccessFile;
 }  // namespace arrow
 
 namespace parquet {
-class Statistics;
+namespace arrow {
+class FileReader;
 }
+}  // namespace parquet
 
 namespace hermes {
 
+struct RowGroupInfo;
 struct FileInfo {
 public:
     enum class FileType { event, transaction, transaction_group };
@@ -34,30 +41,61 @@ public:
 
     std::string name;
 
+    // row groups in file order
+    std::vector<const RowGroupInfo *> row_groups;
+
+    // the schema comes from the manifest if possible. the footer is only read when the
+    // first row group is decoded
+    mutable std::shared_ptr<arrow::Schema> schema;
+    mutable std::shared_ptr<parquet::arrow::FileReader> reader;
+    std::shared_ptr<arrow::fs::FileSystem> fs;
+    // parquet file reader is not thread-safe
+    mutable std::mutex reader_mutex;
+
     static std::string type_str(FileType type);
 };
 
+// handle to a single row group inside a parquet file. the actual arrow table is not
+// loaded until it is requested
+struct RowGroupInfo {
+public:
+    RowGroupInfo(const FileInfo *file, uint64_t row_group, uint64_t num_rows)
+        : file(file), row_group(row_group), num_rows(num_rows) {}
+    const FileInfo *file;
+    uint64_t row_group;
+    uint64_t num_rows;
+
+    // used for pruning. for transactions the time range is [min(start_time), max(end_time)].
+    // unknown ranges cover everything
+    uint64_t min_time = 0;
+    uint64_t max_time = std::numeric_limits<uint64_t>::max();
+    uint64_t min_id = 0;
+    uint64_t max_id = std::numeric_limits<uint64_t>::max();
+
+    [[nodiscard]] bool contains_id(uint64_t id) const { return min_id <= id && id <= max_id; }
+    [[nodiscard]] bool contains_time(uint64_t min, uint64_t max) const {
+        return min_time <= max && min <= max_time;
+    }
+};
+
 struct LoaderResult {
-    const arrow::Table *table;
+    const RowGroupInfo *row_group;
     std::string name;
 };
 
-struct FileMetadata {
-public:
-    using Value = std::map<std::string, std::vector<std::shared_ptr<parquet::Statistics>>>;
-    FileMetadata() = default;
-    void emplace(const FileInfo *key, const Value &value) { data_.emplace(key, value); }
-
-    Value &operator[](const FileInfo *key) { return data_[key]; }
-
-    [[nodiscard]] const Value &at(const FileInfo *info) const { return data_.at(info); }
+// row group time and id ranges, built once when the directory is opened
+struct RowGroupIndex {
+    IntervalIndex<const RowGroupInfo *> time;
+    IntervalIndex<const RowGroupInfo *> id;
 
-    uint64_t size(const FileInfo *file) { return data_.at(file).begin()->second.size(); }
-
-private:
-    std::unordered_map<const FileInfo *,
-                       std::map<std::string, std::vector<std::shared_ptr<parquet::Statistics>>>>
-        data_;
+    void add(const RowGroupInfo *row_group) {
+        time.add(row_group->min_time, row_group->max_time, row_group);
+        id.add(row_group->min_id, row_group->max_id, row_group);
+    }
+    void build() {
+        time.build();
+        id.build();
+    }
 };
 
 struct TransactionData {
@@ -91,8 +129,7 @@ public:
     TransactionData operator*() const;
 
     inline TransactionDataIter &operator++() {
-        current_row_++;
-        compute_index();
+        next();
         return *this;
     }
 
@@ -108,7 +145,7 @@ public:
         return a.current_row_ != b.current_row_;
     }
 
-    inline TransactionDataIter operator+(uint32_t index) {
+    inline TransactionDataIter operator+(uint64_t index) {
         return TransactionDataIter(stream_, current_row_ + index);
     }
 
@@ -116,17 +153,27 @@ private:
     const TransactionStream *stream_;
     uint64_t current_row_ = 0;
 
-    uint64_t table_index_;
-    std::pair<bool, const arrow::Table *> table_entry_;
+    // table the current row belongs to and the position of the row inside of it
+    uint64_t table_ = 0;
+    uint64_t offset_ = 0;
+    // row inside the row group, after the row mapping is applied
+    uint64_t table_index_ = 0;
+    // position in the row mapping of the current table, only used by filtered streams
+    RowBitmap::iterator row_;
+    std::pair<bool, const RowGroupInfo *> table_entry_;
 
+    // binary search over the table offsets
     void compute_index();
+    // constant time for sequential access
+    void next();
+    void update_entry();
 };
 
 class Loader;
 class TransactionStream {
 public:
     // <is_group, table>
-    TransactionStream(const std::vector<std::pair<bool, const arrow::Table *>> &tables,
+    TransactionStream(const std::vector<std::pair<bool, const RowGroupInfo *>> &tables,
                       Loader *loader);
 
     [[nodiscard]] inline TransactionDataIter begin() const { return TransactionDataIter(this, 0); }
@@ -137,19 +184,35 @@ public:
     [[nodiscard]] uint64_t size() const { return num_entries_; }
 
     TransactionStream where(const std::function<bool(const TransactionData &data)> &filter) const;
+    // rows selected by both or by either of the streams. both streams have to be filtered from
+    // the same stream
+    [[nodiscard]] TransactionStream intersect(const TransactionStream &other) const;
+    [[nodiscard]] TransactionStream unite(const TransactionStream &other) const;
+
+    // set to CacheHint::scan for a one-off pass over the stream so that it doesn't push the
+    // working set out of the loader caches
+    void set_cache_hint(CacheHint hint) { cache_hint_ = hint; }
+    [[nodiscard]] CacheHint cache_hint() const { return cache_hint_; }
 
     [[nodiscard]] std::string json() const;
 
 private:
-    std::map<uint64_t, std::pair<bool, const arrow::Table *>> tables_;
+    std::vector<std::pair<bool, const RowGroupInfo *>> tables_;
+    // prefix sum of the number of rows per table. offsets_[i] is the first row of table i and
+    // the last entry is the total number of rows
+    std::vector<uint64_t> offsets_ = {0};
     uint64_t num_entries_ = 0;
     Loader *loader_ = nullptr;
+    CacheHint cache_hint_ = CacheHint::normal;
 
-    // row mapping, used for filtering
-    std::optional<std::vector<std::vector<uint64_t>>> row_mapping_;
+    // selected rows of each table, used for filtering. the selections are immutable, so
+    // chained filters share them instead of copying
+    std::shared_ptr<const std::vector<RowBitmap>> row_mapping_;
 
-    TransactionStream(const std::vector<std::pair<bool, const arrow::Table *>> &tables,
-                      Loader *loader, std::vector<std::vector<uint64_t>> row_mapping);
+    TransactionStream(const std::vector<std::pair<bool, const RowGroupInfo *>> &tables,
+                      Loader *loader, std::shared_ptr<const std::vector<RowBitmap>> row_mapping);
+
+    TransactionStream combine(const TransactionStream &other, bool intersect) const;
 
     TransactionStream() = default;
 
@@ -170,6 +233,18 @@ struct LoaderStats {
     uint64_t average_transaction_group_chunk_size = 0;
 };
 
+// selects what Loader::stream replays
+struct StreamOptions {
+    // event, transaction and group names, or glob patterns using the same syntax as the
+    // message bus topics. empty means everything
+    std::vector<std::string> topics;
+    // only items whose time falls into [start_time, end_time] are published. transactions and
+    // groups are keyed by their start time
+    uint64_t start_time = 0;
+    uint64_t end_time = std::numeric_limits<uint64_t>::max();
+    bool stream_transactions = true;
+};
+
 // define table schema so that some downstream tools can directly
 // interact with the raw parquet files
 enum class EventDataType { bool_, uint8_t_, uint16_t_, uint32_t_, uint64_t_, string };
@@ -205,7 +280,20 @@ public:
                                                               uint64_t start_time,
                                                               uint64_t end_time);
 
-    std::shared_ptr<EventBatch> get_events(const Transaction &transaction);
+    std::shared_ptr<EventBatch> get_events(const Transaction &transaction,
+                                           CacheHint hint = CacheHint::normal);
+    // one event batch per transaction. all the event ids are resolved in a single pass
+    std::vector<std::shared_ptr<EventBatch>> get_events(
+        const std::vector<std::shared_ptr<Transaction>> &transactions,
+        CacheHint hint = CacheHint::normal);
+
+    // columnar access. one batch per row group, backed by the decoded arrow buffers.
+    // these are not cached
+    std::vector<std::shared_ptr<ColumnarEventBatch>> get_columnar_events(uint64_t min_time,
+                                                                         uint64_t max_time);
+    std::vector<std::shared_ptr<ColumnarEventBatch>> get_columnar_events(const std::string &name,
+                                                                         uint64_t min_time,
+                                                                         uint64_t max_time);
 
     [[nodiscard]] BatchSchema get_event_schema(const std::string &name);
 
@@ -215,18 +303,32 @@ public:
 
     // access to raw data
     [[nodiscard]] const std::map<std::pair<const FileInfo *, uint64_t>,
-                                 std::shared_ptr<arrow::Table>>
+                                 std::unique_ptr<RowGroupInfo>>
         &tables() const {
         return tables_;
     }
+    // decode the row group from the underlying parquet file
+    std::shared_ptr<arrow::Table> load_table(const RowGroupInfo *row_group);
 
     void stream(bool stream_transactions = true);
     void stream(MessageBus *bus, bool stream_transactions = true);
+    // row groups outside of the selected topics and time window are never decoded
+    void stream(const StreamOptions &options);
+    void stream(MessageBus *bus, const StreamOptions &options);
 
     // debug information
     [[maybe_unused]] void print_files() const;
     void preload();
 
+    // memory budget in bytes shared by all the decoded batches. defaults to half of the
+    // system memory
+    void set_cache_budget(uint64_t bytes);
+    [[nodiscard]] uint64_t cache_budget() const;
+    [[nodiscard]] CacheStats cache_stats(FileInfo::FileType type) const;
+    // replacement policy of each cache. defaults to 2Q
+    void set_cache_policy(FileInfo::FileType type, CachePolicy policy);
+    [[nodiscard]] CachePolicy cache_policy(FileInfo::FileType type) const;
+
 private:
     std::mutex files_mutex_;
     std::vector<std::unique_ptr<FileInfo>> files_;
@@ -234,35 +336,42 @@ private:
     std::vector<const FileInfo *> events_;
     std::vector<const FileInfo *> transactions_;
     std::vector<const FileInfo *> transaction_groups_;
-    std::map<std::pair<const FileInfo *, uint64_t>, std::shared_ptr<arrow::Table>> tables_;
-    // we store all the statistics here
-    FileMetadata file_metadata_;
-    // local caches
-    std::mutex event_cache_mutex_;
-    std::unique_ptr<lru_cache<const arrow::Table *, std::shared_ptr<EventBatch>>> event_cache_;
-    std::mutex transaction_cache_mutex_;
-    std::unique_ptr<lru_cache<const arrow::Table *, std::shared_ptr<TransactionBatch>>>
-        transaction_cache_;
-    std::mutex transaction_group_cache_mutex_;
-    std::unique_ptr<lru_cache<const arrow::Table *, std::shared_ptr<TransactionGroupBatch>>>
-        transaction_group_cache_;
+    std::map<std::pair<const FileInfo *, uint64_t>, std::unique_ptr<RowGroupInfo>> tables_;
+    // query planning indices, per file type and per (file type, name)
+    std::map<FileInfo::FileType, RowGroupIndex> type_index_;
+    std::map<std::pair<FileInfo::FileType, std::string>, RowGroupIndex> name_index_;
+    // local caches. these are thread-safe and share the same memory budget
+    using EventCache = ShardedCache<const RowGroupInfo *, std::shared_ptr<EventBatch>>;
+    using TransactionCache = ShardedCache<const RowGroupInfo *, std::shared_ptr<TransactionBatch>>;
+    using TransactionGroupCache =
+        ShardedCache<const RowGroupInfo *, std::shared_ptr<TransactionGroupBatch>>;
+    std::unique_ptr<EventCache> event_cache_;
+    std::unique_ptr<TransactionCache> transaction_cache_;
+    std::unique_ptr<TransactionGroupCache> transaction_group_cache_;
     // stats about the folder we're reading
     LoaderStats stats_;
-    // lookup table for event id lists
-    // this will be read-only so no mutex protection
-    std::map<uint64_t, std::pair<const FileInfo *, uint64_t>> event_id_index_;
-    // only if we have preloaded everything
-    bool preloaded_ = false;
 
     void open_dir(const FileSystemInfo &info);
-    void load_json(const std::string &json_info, const std::shared_ptr<arrow::fs::FileSystem> &fs);
-    bool preload_table(const FileInfo *info,
-                       const std::shared_ptr<arrow::io::RandomAccessFile> &file);
-    std::vector<LoaderResult> load_tables(
-        const std::vector<std::pair<const FileInfo *, std::vector<uint64_t>>> &files);
-    std::shared_ptr<EventBatch> load_events(const arrow::Table *table);
-    std::shared_ptr<TransactionBatch> load_transactions(const arrow::Table *table);
-    std::shared_ptr<TransactionGroupBatch> load_transaction_groups(const arrow::Table *table);
+    bool load_manifest(const std::string &content, const std::string &dir,
+                       const std::shared_ptr<arrow::fs::FileSystem> &fs);
+    // legacy layout with one json file per parquet file and a checkpoint.json
+    void load_json(const std::string &json_info, const std::shared_ptr<arrow::fs::FileSystem> &fs,
+                   const std::unordered_set<std::string> &skip_files);
+    bool load_footer(FileInfo *info, const std::shared_ptr<arrow::io::RandomAccessFile> &file);
+    void add_file(std::unique_ptr<FileInfo> info);
+    void add_row_group(FileInfo *file, std::unique_ptr<RowGroupInfo> row_group);
+    std::shared_ptr<EventBatch> load_events(const RowGroupInfo *row_group,
+                                            CacheHint hint = CacheHint::normal);
+    // resolves event ids in sorted order and fetches each row group once. unknown ids
+    // are set to nullptr
+    std::vector<std::shared_ptr<Event>> resolve_events(const std::vector<uint64_t> &ids,
+                                                       CacheHint hint);
+    std::vector<std::shared_ptr<ColumnarEventBatch>> load_columnar_events(
+        const std::vector<LoaderResult> &tables);
+    std::shared_ptr<TransactionBatch> load_transactions(const RowGroupInfo *row_group,
+                                                        CacheHint hint = CacheHint::normal);
+    std::shared_ptr<TransactionGroupBatch> load_transaction_groups(
+        const RowGroupInfo *row_group, CacheHint hint = CacheHint::normal);
     void compute_stats();
 
     // only return the table
@@ -271,15 +380,20 @@ private:
                                                      uint64_t min_time, uint64_t max_time);
     std::vector<LoaderResult> load_transaction_group_table(const std::optional<std::string> &name,
                                                            uint64_t min_time, uint64_t max_time);
-    std::vector<LoaderResult> load_batch_table(const std::vector<const FileInfo *> &info,
+    std::vector<LoaderResult> load_batch_table(FileInfo::FileType type,
                                                const std::optional<std::string> &name,
                                                uint64_t min_time, uint64_t max_time);
-    bool contains_time(const FileInfo *file, uint64_t chunk_id, uint64_t min_time,
-                       uint64_t max_time);
+    const RowGroupIndex *get_index(FileInfo::FileType type,
+                                   const std::optional<std::string> &name) const;
+    // row groups of the given type whose id range contains the id
+    std::vector<const RowGroupInfo *> find_row_groups(FileInfo::FileType type, uint64_t id) const;
     void init_cache();
-    void compute_event_id_index();
+    void build_index();
 
-    static uint64_t compute_table_size_in_memory(const std::shared_ptr<arrow::Table> &table);
+    // needs to hold the file's reader lock
+    static bool open_reader(const FileInfo *file);
+    static uint64_t compute_table_size_in_memory(const std::shared_ptr<arrow::Schema> &schema,
+                                                 uint64_t num_rows);
     static std::vector<std::string> load_checkpoint_info(
         const std::shared_ptr<arrow::io::RandomAccessFile> &file);
 
@@ -0,0 +1,176 @@
+#ifndef HERMES_POOL_HH
+#define HERMES_POOL_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace hermes {
+
+// pool of fixed-size blocks. freed blocks go to a per-thread cache first and are handed back to
+// the shared free list in batches, so objects can be freed on a different thread (e.g. the
+// serializer) than the one allocating them (e.g. the simulator) without taking a lock per object.
+// memory is kept for reuse and never returned to the system
+template <std::size_t Size, std::size_t Align>
+class BlockPool {
+public:
+    // number of blocks moved between a thread cache and the shared free list at once
+    static constexpr std::size_t batch_size = 256;
+
+    static BlockPool &get() {
+        // never destroyed, since thread caches return their blocks when the thread exits
+        static auto *pool = new BlockPool();
+        return *pool;
+    }
+
+    void *allocate() {
+        auto &cache = local_cache();
+        if (!cache.head) refill(cache);
+        auto *node = cache.head;
+        cache.head = node->next;
+        cache.size--;
+        return node;
+    }
+
+    void deallocate(void *ptr) {
+        auto &cache = local_cache();
+        auto *node = static_cast<Node *>(ptr);
+        if (cache.exited) {
+            node->next = nullptr;
+            std::lock_guard guard(mutex_);
+            free_.emplace_back(Batch{node, 1});
+            return;
+        }
+        node->next = cache.head;
+        cache.head = node;
+        cache.size++;
+        if (cache.size >= 2 * batch_size) release(cache, batch_size);
+    }
+
+    // total number of blocks carved out so far
+    [[nodiscard]] std::size_t capacity() {
+        std::lock_guard guard(mutex_);
+        return slabs_.size() * slab_size;
+    }
+
+private:
+    struct Node {
+        Node *next;
+    };
+    struct Batch {
+        Node *head;
+        std::size_t size;
+    };
+    struct Cache {
+        Node *head;
+        std::size_t size;
+        // set once the thread exits. blocks freed after that, e.g. by static destructors, go
+        // straight to the shared free list
+        bool exited;
+    };
+    struct CacheGuard {
+        ~CacheGuard() {
+            auto &cache = local_cache();
+            if (cache.head) get().release(cache, cache.size);
+            cache.exited = true;
+        }
+    };
+
+    static constexpr std::size_t block_align = std::max(Align, alignof(Node));
+    static constexpr std::size_t block_size =
+        (std::max(Size, sizeof(Node)) + block_align - 1) / block_align * block_align;
+    static constexpr std::size_t slab_size = 4 * batch_size;
+
+    std::mutex mutex_;
+    std::vector<Batch> free_;
+    std::vector<void *> slabs_;
+
+    BlockPool() = default;
+
+    static Cache &local_cache() {
+        // trivially destructible, so it is still usable after the guard has run
+        thread_local Cache cache = {nullptr, 0, false};
+        thread_local CacheGuard guard;
+        return cache;
+    }
+
+    void refill(Cache &cache) {
+        std::lock_guard guard(mutex_);
+        if (!free_.empty()) {
+            auto batch = free_.back();
+            free_.pop_back();
+            cache.head = batch.head;
+            cache.size = batch.size;
+            return;
+        }
+        auto *slab = static_cast<std::byte *>(
+            ::operator new(slab_size * block_size, std::align_val_t(block_align)));
+        slabs_.emplace_back(slab);
+        for (auto i = slab_size; i > 0; i--) {
+            auto *node = reinterpret_cast<Node *>(slab + (i - 1) * block_size);
+            node->next = cache.head;
+            cache.head = node;
+        }
+        cache.size = slab_size;
+    }
+
+    // moves the first count blocks of the cache to the shared free list
+    void release(Cache &cache, std::size_t count) {
+        auto *head = cache.head;
+        auto *tail = head;
+        for (std::size_t i = 1; i < count; i++) tail = tail->next;
+        cache.head = tail->next;
+        cache.size -= count;
+        tail->next = nullptr;
+        std::lock_guard guard(mutex_);
+        free_.emplace_back(Batch{head, count});
+    }
+};
+
+// stl allocator backed by block pools. single objects, which is what allocate_shared asks for,
+// come from the pool that matches their size; arrays fall back to the global heap
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) noexcept {}  // NOLINT
+
+    T *allocate(std::size_t n) {
+        if (n == 1) return static_cast<T *>(BlockPool<sizeof(T), alignof(T)>::get().allocate());
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept {
+        if (n == 1) {
+            BlockPool<sizeof(T), alignof(T)>::get().deallocate(ptr);
+        } else {
+            std::allocator<T>().deallocate(ptr, n);
+        }
+    }
+
+    template <typename U>
+    friend bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+        return true;
+    }
+    template <typename U>
+    friend bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &) {
+        return false;
+    }
+};
+
+// same as std::make_shared, except that the object and its control block are recycled through a
+// pool once the last reference is gone
+template <typename T, typename... Args>
+std::shared_ptr<T> make_pooled(Args &&...args) {
+    return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+}
+
+}  // namespace hermes
+
+#endif  // HERMES_POOL_HH
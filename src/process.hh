@@ -1,12 +1,17 @@
 #ifndef HERMES_PROCESS_HH
 #define HERMES_PROCESS_HH
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdio>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <string>
 #include <thread>
@@ -124,6 +129,226 @@ inline ThreadPool::~ThreadPool() {
     for (std::thread &worker : workers) worker.join();
 }
 
+// process-wide work-stealing executor. every worker owns a deque: it pushes and pops its own
+// tasks at the back and steals from the front of the others when it runs dry. tasks submitted
+// from outside go to a shared queue. threads that wait for tasks help running them, so nested
+// parallel_for calls from inside a task don't deadlock or oversubscribe the machine
+class Executor {
+public:
+    explicit Executor(uint64_t num_threads);
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+    ~Executor();
+
+    // shared by the loader, transaction streams and checkers
+    static Executor &global();
+    // has to be called before the global executor is used, otherwise it's ignored. 0 means
+    // the number of hardware threads
+    static void set_global_num_threads(uint64_t num_threads);
+
+    [[nodiscard]] uint64_t num_threads() const { return workers_.size(); }
+
+    template <typename F>
+    auto submit(F &&func) -> std::future<decltype(func())>;
+
+    // calls func(i) for every i in [begin, end) and waits for all of them. the first exception
+    // thrown by func is rethrown
+    template <typename F>
+    void parallel_for(uint64_t begin, uint64_t end, F &&func);
+
+    // waits for the future while running other tasks
+    template <typename T>
+    T get(std::future<T> &future);
+
+    // runs a single pending task. returns false if there is nothing to run
+    bool run_one();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::mutex queue_mutex_;
+    std::deque<std::function<void()>> queue_;
+
+    // sleeping workers wait for pending_ to become non-zero
+    std::mutex sleep_mutex_;
+    std::condition_variable condition_;
+    std::atomic<uint64_t> pending_ = 0;
+    bool stop_ = false;
+
+    // index of the current thread if it is one of our workers
+    std::optional<uint64_t> worker_index() const;
+    void push(std::function<void()> task);
+    std::optional<std::function<void()>> pop();
+    void run(uint64_t index);
+
+    static std::atomic<uint64_t> &global_num_threads() {
+        static std::atomic<uint64_t> num_threads = 0;
+        return num_threads;
+    }
+};
+
+namespace executor {
+// worker identity of the current thread
+inline thread_local const Executor *current = nullptr;
+inline thread_local uint64_t current_index = 0;
+}  // namespace executor
+
+inline Executor::Executor(uint64_t num_threads) {
+    num_threads = std::max<uint64_t>(num_threads, 1);
+    workers_.reserve(num_threads);
+    for (uint64_t i = 0; i < num_threads; i++) workers_.emplace_back(std::make_unique<Worker>());
+    threads_.reserve(num_threads);
+    for (uint64_t i = 0; i < num_threads; i++) threads_.emplace_back([this, i]() { run(i); });
+}
+
+inline Executor::~Executor() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    for (auto &thread : threads_) thread.join();
+}
+
+inline Executor &Executor::global() {
+    static Executor executor([]() -> uint64_t {
+        auto num_threads = global_num_threads().load();
+        if (num_threads == 0) num_threads = std::thread::hardware_concurrency();
+        return num_threads;
+    }());
+    return executor;
+}
+
+inline void Executor::set_global_num_threads(uint64_t num_threads) {
+    global_num_threads() = num_threads;
+}
+
+inline std::optional<uint64_t> Executor::worker_index() const {
+    if (executor::current == this) return executor::current_index;
+    return std::nullopt;
+}
+
+inline void Executor::push(std::function<void()> task) {
+    {
+        // counted before the task is visible so that pending_ never underflows. taking the lock
+        // makes sure a worker that is about to sleep sees the new task
+        std::lock_guard guard(sleep_mutex_);
+        pending_++;
+    }
+    if (auto index = worker_index()) {
+        auto &worker = *workers_[*index];
+        std::lock_guard guard(worker.mutex);
+        worker.tasks.emplace_back(std::move(task));
+    } else {
+        std::lock_guard guard(queue_mutex_);
+        queue_.emplace_back(std::move(task));
+    }
+    condition_.notify_one();
+}
+
+inline std::optional<std::function<void()>> Executor::pop() {
+    std::optional<std::function<void()>> task;
+    auto take = [&task, this](std::mutex &mutex, std::deque<std::function<void()>> &tasks,
+                              bool back) {
+        std::lock_guard guard(mutex);
+        if (tasks.empty()) return false;
+        if (back) {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        } else {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        pending_--;
+        return true;
+    };
+    // own tasks first, newest first since they are likely still in cache
+    auto index = worker_index();
+    if (index && take(workers_[*index]->mutex, workers_[*index]->tasks, true)) return task;
+    if (take(queue_mutex_, queue_, false)) return task;
+    // steal the oldest task of somebody else, which tends to be the largest one
+    auto start = index ? *index + 1 : 0;
+    for (uint64_t i = 0; i < workers_.size(); i++) {
+        auto &worker = *workers_[(start + i) % workers_.size()];
+        if (take(worker.mutex, worker.tasks, false)) return task;
+    }
+    return std::nullopt;
+}
+
+inline bool Executor::run_one() {
+    auto task = pop();
+    if (!task) return false;
+    (*task)();
+    return true;
+}
+
+inline void Executor::run(uint64_t index) {
+    executor::current = this;
+    executor::current_index = index;
+    while (true) {
+        if (run_one()) continue;
+        std::unique_lock lock(sleep_mutex_);
+        condition_.wait(lock, [this]() { return stop_ || pending_ > 0; });
+        if (stop_ && pending_ == 0) return;
+    }
+}
+
+template <typename F>
+auto Executor::submit(F &&func) -> std::future<decltype(func())> {
+    using return_type = decltype(func());
+    auto task = std::make_shared<std::packaged_task<return_type()>>(std::forward<F>(func));
+    auto result = task->get_future();
+    push([task]() { (*task)(); });
+    return result;
+}
+
+template <typename F>
+void Executor::parallel_for(uint64_t begin, uint64_t end, F &&func) {
+    if (begin >= end) return;
+    struct Group {
+        std::atomic<uint64_t> remaining;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::exception_ptr exception;
+    };
+    auto group = std::make_shared<Group>();
+    group->remaining = end - begin;
+    for (auto i = begin; i < end; i++) {
+        push([group, i, &func]() {
+            try {
+                func(i);
+            } catch (...) {
+                std::lock_guard guard(group->mutex);
+                if (!group->exception) group->exception = std::current_exception();
+            }
+            if (--group->remaining == 0) {
+                std::lock_guard guard(group->mutex);
+                group->condition.notify_all();
+            }
+        });
+    }
+    while (group->remaining > 0) {
+        if (run_one()) continue;
+        // other threads are running the rest. wake up once in a while to help with new tasks
+        std::unique_lock lock(group->mutex);
+        group->condition.wait_for(lock, std::chrono::milliseconds(1),
+                                  [&group]() { return group->remaining == 0; });
+    }
+    if (group->exception) std::rethrow_exception(group->exception);
+}
+
+template <typename T>
+T Executor::get(std::future<T> &future) {
+    while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        if (!run_one()) future.wait_for(std::chrono::milliseconds(1));
+    }
+    return future.get();
+}
+
 }  // namespace hermes
 
 #endif  // HERMES_PROCESS_HH
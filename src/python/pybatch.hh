@@ -4,6 +4,8 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include "../event.hh"
+
 namespace py = pybind11;
 
 template <typename T>
@@ -59,13 +61,23 @@ void init_values(py::class_<T, std::shared_ptr<T>> &obj, const char *add_value_n
     obj.def(add_value_name, &T::template add_value<std::string>, py::arg("name"), py::arg("value"));
 
     obj.def("__getattr__", [](const T &t, const std::string &name) -> py::object {
-        auto const &values = t.values();
-        if (values.find(name) == values.end()) {
-            throw py::value_error("Event object does not have attribute " + name);
+        if constexpr (std::is_same_v<T, hermes::Event>) {
+            // resolved in place, since values() would compose every attribute
+            if (name == hermes::Event::TIME_NAME) return py::cast(t.time());
+            if (name == hermes::Event::ID_NAME) return py::cast(t.id());
+            if (name == hermes::Event::NAME_NAME) return py::cast(t.name());
+            auto index = t.schema().find(name);
+            if (index >= 0) {
+                return py::detail::visit_helper<std::variant>::call(visitor(), t.slots()[index]);
+            }
         } else {
-            auto const &v = values.at(name);
-            return py::detail::visit_helper<std::variant>::call(visitor(), v);
+            auto const &values = t.values();
+            auto it = values.find(name);
+            if (it != values.end()) {
+                return py::detail::visit_helper<std::variant>::call(visitor(), it->second);
+            }
         }
+        throw py::value_error("Event object does not have attribute " + name);
     });
     // through get item
     obj.def("__getitem__", [](const T &e, const std::string &name) {
@@ -67,6 +67,13 @@ void init_checker(py::module &m) {
     checker.def_property("assert_exception", &Checker_::assert_exception,
                          &Checker_::set_assert_exception);
     checker.def_property("stateless", &Checker_::stateless, &Checker_::set_stateless);
+    checker.def("set_partition_key",
+                py::overload_cast<const std::string &>(&Checker_::set_partition_key),
+                py::arg("name"));
+    checker.def("set_partition_key",
+                py::overload_cast<hermes::Checker::PartitionKey>(&Checker_::set_partition_key),
+                py::arg("func"));
+    checker.def_property_readonly("partitioned", &Checker_::partitioned);
 
     py::register_exception<hermes::CheckerAssertion>(m, "CheckerAssertion");
 
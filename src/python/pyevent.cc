@@ -1,5 +1,6 @@
 #include "../event.hh"
 #include "../json.hh"
+#include "../pool.hh"
 #include "../pubsub.hh"
 #include "pybatch.hh"
 
@@ -17,7 +18,8 @@ void init_event_util(py::module &m) {
 
 void init_event(py::module &m) {
     auto event = py::class_<hermes::Event, std::shared_ptr<hermes::Event>>(m, "Event");
-    event.def(py::init<uint64_t>(), py::arg("time"));
+    event.def(py::init([](uint64_t time) { return hermes::make_pooled<hermes::Event>(time); }),
+              py::arg("time"));
 
     event.def(
         "json",
@@ -30,12 +32,9 @@ void init_event(py::module &m) {
 
     event.def("__repr__", [](const hermes::Event &event) {
         // repr is expensive so it's for debugging only
-        auto const &values = event.values();
         auto result = py::dict();
-        for (auto const &[name, v] : values) {
-            auto value = py::detail::visit_helper<std::variant>::call(visitor(), v);
-            result[name.c_str()] = value;
-        }
+        event.for_each_value(
+            [&result](const char *name, const auto &value) { result[name] = py::cast(value); });
         return py::str(result);
     });
 
@@ -25,6 +25,10 @@ void init_serializer(py::module &m) {
     serializer.def(py::init<const hermes::FileSystemInfo &, bool>(), py::arg("output_dir"),
                    py::arg("override") = true);
     serializer.def("finalize", &hermes::Serializer::finalize);
+    serializer.def("set_async", &hermes::Serializer::set_async, py::arg("value"),
+                   py::arg("queue_depth") = hermes::Serializer::default_queue_depth,
+                   py::arg("num_workers") = 1);
+    serializer.def_property_readonly("is_async", &hermes::Serializer::async);
 }
 
 void init_query(py::module &m) {
@@ -42,6 +42,19 @@ void init_stream(py::module &m) {
         pybind11::gil_scoped_acquire acquire;
         return res;
     });
+
+    stream.def("__and__", &hermes::TransactionStream::intersect, py::arg("other"));
+    stream.def("__or__", &hermes::TransactionStream::unite, py::arg("other"));
+
+    // one-off passes should not evict the cached batches
+    stream.def_property(
+        "scan",
+        [](const hermes::TransactionStream &stream) {
+            return stream.cache_hint() == hermes::CacheHint::scan;
+        },
+        [](hermes::TransactionStream &stream, bool scan) {
+            stream.set_cache_hint(scan ? hermes::CacheHint::scan : hermes::CacheHint::normal);
+        });
 }
 
 uint64_t get_size(const hermes::TransactionData &t) {
@@ -193,6 +206,20 @@ void init_loader(py::module &m) {
                });
     loader.def("stream", [](hermes::Loader &loader) { loader.stream(); });
     loader.def("stream", py::overload_cast<bool>(&hermes::Loader::stream));
+    loader.def(
+        "stream",
+        [](hermes::Loader &loader, const std::vector<std::string> &topics, uint64_t start,
+           uint64_t end, bool stream_transactions) {
+            hermes::StreamOptions options;
+            options.topics = topics;
+            options.start_time = start;
+            options.end_time = end;
+            options.stream_transactions = stream_transactions;
+            loader.stream(options);
+        },
+        py::arg("topics"), py::arg("start") = 0,
+        py::arg("end") = std::numeric_limits<uint64_t>::max(),
+        py::arg("stream_transactions") = true);
 
     loader.def_property_readonly("event_names", &hermes::Loader::get_event_names);
     loader.def_property_readonly("transaction_names", &hermes::Loader::get_transaction_names);
@@ -201,6 +228,8 @@ void init_loader(py::module &m) {
 
     loader.def("get_event_schema", &hermes::Loader::get_event_schema, py::arg("event_name"));
     loader.def("print_files", &hermes::Loader::print_files);
+    loader.def_property("cache_budget", &hermes::Loader::cache_budget,
+                        &hermes::Loader::set_cache_budget);
 
     init_stream(m);
     init_data(m);
@@ -1,10 +1,11 @@
+#include "../pool.hh"
 #include "../transaction.hh"
 #include "pybatch.hh"
 
 void init_transaction(py::module &m) {
     auto transaction =
         py::class_<hermes::Transaction, std::shared_ptr<hermes::Transaction>>(m, "Transaction");
-    transaction.def(py::init<>());
+    transaction.def(py::init([]() { return hermes::make_pooled<hermes::Transaction>(); }));
     transaction.def(
         "add_event",
         py::overload_cast<const std::shared_ptr<hermes::Event> &>(&hermes::Transaction::add_event),
@@ -25,7 +26,8 @@ void init_transaction(py::module &m) {
     auto transaction_group =
         py::class_<hermes::TransactionGroup, std::shared_ptr<hermes::TransactionGroup>>(
             m, "TransactionGroup");
-    transaction_group.def(py::init<>());
+    transaction_group.def(
+        py::init([]() { return hermes::make_pooled<hermes::TransactionGroup>(); }));
     transaction_group.def("add_transaction",
                           py::overload_cast<const std::shared_ptr<hermes::TransactionGroup> &>(
                               &hermes::TransactionGroup::add_transaction));
@@ -0,0 +1,35 @@
+#ifndef HERMES_SEARCH_HH
+#define HERMES_SEARCH_HH
+
+#include <cstdint>
+
+namespace hermes {
+
+// branchless binary searches over a sorted array. the loop always runs log2(n) steps and the
+// comparison compiles to a conditional move, so there is no branch to mispredict. both return
+// the index of the result, which is size if there is none
+inline uint64_t branchless_lower_bound(const uint64_t *data, uint64_t size, uint64_t value) {
+    if (size == 0) return 0;
+    const uint64_t *base = data;
+    while (size > 1) {
+        auto half = size / 2;
+        base = base[half] < value ? base + half : base;
+        size -= half;
+    }
+    return static_cast<uint64_t>(base - data) + (*base < value);
+}
+
+inline uint64_t branchless_upper_bound(const uint64_t *data, uint64_t size, uint64_t value) {
+    if (size == 0) return 0;
+    const uint64_t *base = data;
+    while (size > 1) {
+        auto half = size / 2;
+        base = base[half] <= value ? base + half : base;
+        size -= half;
+    }
+    return static_cast<uint64_t>(base - data) + (*base <= value);
+}
+
+}  // namespace hermes
+
+#endif  // HERMES_SEARCH_HH
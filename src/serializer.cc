@@ -1,18 +1,20 @@
 #include "serializer.hh"
 
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
+#include <limits>
 #include <utility>
 
 #include "arrow/api.h"
 #include "arrow/filesystem/localfs.h"
 #include "arrow/ipc/reader.h"
+#include "arrow/util/compression.h"
 #include "fmt/format.h"
 #include "json.hh"
 #include "logger.hh"
 #include "parquet/arrow/writer.h"
 #include "parquet/metadata.h"
-#include "rapidjson/prettywriter.h"
 #include "rapidjson/stringbuffer.h"
 #include "rapidjson/writer.h"
 
@@ -39,86 +41,229 @@ Serializer::Serializer(FileSystemInfo info, bool override) : output_dir_(std::mo
         return;
     }
 
+    // default to snappy
+    set_options(SerializerOptions());
+
+    if (!override) {
+        identify_batch_counter();
+        append_manifest_ = true;
+    }
+}
+
+arrow::Compression::type get_compression_type(CompressionCodec codec) {
+    switch (codec) {
+        case CompressionCodec::none:
+            return arrow::Compression::UNCOMPRESSED;
+        case CompressionCodec::snappy:
+            return arrow::Compression::SNAPPY;
+        case CompressionCodec::lz4:
+            return arrow::Compression::LZ4;
+        case CompressionCodec::zstd:
+            return arrow::Compression::ZSTD;
+    }
+    return arrow::Compression::UNCOMPRESSED;
+}
+
+bool Serializer::set_options(const SerializerOptions &options) {
+    std::vector<CompressionOption> codecs = {options.compression};
+    for (auto const &iter : options.column_compression) codecs.emplace_back(iter.second);
+    for (auto const &option : codecs) {
+        auto type = get_compression_type(option.codec);
+        if (!arrow::util::Codec::IsAvailable(type)) {
+            std::cerr << "[ERROR]: Compression codec " << arrow::util::Codec::GetCodecAsString(type)
+                      << " is not available" << std::endl;
+            return false;
+        }
+    }
+
     // we use version 2.0
     auto builder = parquet::WriterProperties::Builder();
     builder.version(parquet::ParquetVersion::PARQUET_2_0);
-    // we use snappy as the compression scheme
-    builder.compression(arrow::Compression::SNAPPY);
+    // levels are ignored for codecs that don't support them
+    auto has_level = [](const CompressionOption &option) {
+        return option.level &&
+               arrow::util::Codec::SupportsCompressionLevel(get_compression_type(option.codec));
+    };
+    builder.compression(get_compression_type(options.compression.codec));
+    if (has_level(options.compression)) builder.compression_level(*options.compression.level);
+    for (auto const &[name, option] : options.column_compression) {
+        builder.compression(name, get_compression_type(option.codec));
+        if (has_level(option)) builder.compression_level(name, *option.level);
+    }
+
+    // encodings
+    if (!options.dictionary_encoding) builder.disable_dictionary();
+    for (auto const &name : options.monotonic_columns) builder.disable_dictionary(name);
+
     // make sure to use statistic
     builder.enable_statistics();
     builder.max_statistics_size(1 << 20);
     writer_properties_ = builder.build();
-
-    if (!override) {
-        identify_batch_counter();
-    }
+    options_ = options;
+    return true;
 }
 
 bool Serializer::serialize(EventBatch &batch) {
+    if (async_) return enqueue(batch);
+    return write(&batch, batch);
+}
+
+bool Serializer::serialize(TransactionBatch &batch) {
+    if (async_) return enqueue(batch);
+    return write(&batch, batch);
+}
+
+bool Serializer::serialize(TransactionGroupBatch &batch) {
+    if (async_) return enqueue(batch);
+    return write(&batch, batch);
+}
+
+bool Serializer::write(const void *key, EventBatch &batch) {
     if (!ok()) return false;
     auto r = batch.validate();
     if (!r) return false;
     // if it's ordered, we don't need to sort
     if (!event_in_order()) batch.sort();
-    // serialize
-    auto [record, schema] = batch.serialize();
-    auto *writer = get_writer(&batch, schema);
-    auto res = serialize(writer, record);
-    if (!res) return false;
-
-    // write out event batch properties
-    auto &stat = get_stat(&batch);
-    update_stat(stat, batch);
-
-    return true;
+    return write_batch(key, batch);
 }
 
-bool Serializer::serialize(TransactionBatch &batch) {
+bool Serializer::write(const void *key, TransactionBatch &batch) {
     if (!ok()) return false;
     // we have to sort the transaction because of the way that
     // each transaction retires
     batch.sort();
-    // serialize
-    auto [record, schema] = batch.serialize();
-    auto *writer = get_writer(&batch, schema);
-    auto res = serialize(writer, record);
-    if (!res) return false;
-
-    // write out event batch properties
-    auto &stat = get_stat(&batch);
-    update_stat(stat, batch);
-    return true;
+    return write_batch(key, batch);
 }
 
-bool Serializer::serialize(TransactionGroupBatch &batch) {
+bool Serializer::write(const void *key, TransactionGroupBatch &batch) {
     if (!ok()) return false;
     batch.sort();
-    // serialize
+    return write_batch(key, batch);
+}
+
+template <typename T>
+bool Serializer::write_batch(const void *key, const T &batch) {
+    // encoding happens outside any lock so that different sources can be
+    // serialized in parallel
     auto [record, schema] = batch.serialize();
-    auto *writer = get_writer(&batch, schema);
+    if (!record) return false;
+
+    auto *output = get_output(key);
+    std::lock_guard guard(output->mutex);
+    auto *writer = get_writer(output, schema);
     auto res = serialize(writer, record);
     if (!res) return false;
 
-    // write out event batch properties
-    auto &stat = get_stat(&batch);
-    update_stat(stat, batch);
+    // write out batch properties
+    if (!output->stat.schema) output->stat.schema = schema;
+    update_stat(output->stat, batch);
+    return true;
+}
+
+template <typename T>
+bool Serializer::enqueue(T &batch) {
+    if (!ok()) return false;
+    if (batch.empty()) return true;
+    // take over the entries and give the caller a fresh buffer of the same capacity
+    auto size = batch.size();
+    auto task_batch = std::make_shared<T>();
+    batch.move_to(*task_batch);
+    batch.reserve(size);
+
+    {
+        std::unique_lock lock(queue_mutex_);
+        if (workers_.empty()) {
+            stop_worker_ = false;
+            for (uint64_t i = 0; i < num_workers_; i++) {
+                workers_.emplace_back([this]() { process_queue(); });
+            }
+        }
+        // backpressure
+        queue_cond_.wait(lock, [this]() { return queue_.size() < queue_depth_; });
+        queue_.emplace_back(SerializationTask{&batch, std::move(task_batch)});
+    }
+    queue_cond_.notify_all();
     return true;
 }
 
-void Serializer::finalize() {
-    if (writers_.empty()) return;
-    for (auto const &[ptr, writer] : writers_) {
-        (void)writer->Close();
+void Serializer::process_queue() {
+    while (true) {
+        SerializationTask task;
+        {
+            std::unique_lock lock(queue_mutex_);
+            auto it = queue_.end();
+            queue_cond_.wait(lock, [this, &it]() {
+                // batches from the same source have to be written in order, so we skip
+                // sources that another worker is still writing
+                it = std::find_if(queue_.begin(), queue_.end(), [this](const auto &t) {
+                    return busy_keys_.find(t.key) == busy_keys_.end();
+                });
+                // only exit once everything is drained
+                return it != queue_.end() || (stop_worker_ && queue_.empty());
+            });
+            if (it == queue_.end()) return;
+            task = std::move(*it);
+            queue_.erase(it);
+            busy_keys_.emplace(task.key);
+        }
+        queue_cond_.notify_all();
+
+        auto res = std::visit([this, &task](auto &batch) { return write(task.key, *batch); },
+                              task.batch);
+        if (!res) {
+            std::cerr << "[ERROR]: Unable to serialize batch " << task.key << std::endl;
+            // the caller has already returned, so the next serialize() or finalize() reports it
+            has_error_ = true;
+        }
+
+        {
+            std::lock_guard guard(queue_mutex_);
+            busy_keys_.erase(task.key);
+        }
+        queue_cond_.notify_all();
+    }
+}
+
+void Serializer::stop_worker() {
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard guard(queue_mutex_);
+        if (workers_.empty()) return;
+        stop_worker_ = true;
+        workers = std::move(workers_);
+        workers_.clear();
     }
-    for (auto const &[ptr, stat] : stats_) {
-        write_stat(fs_, stat);
+    queue_cond_.notify_all();
+    for (auto &worker : workers) worker.join();
+}
+
+void Serializer::set_async(bool value, uint64_t queue_depth, uint64_t num_workers) {
+    // drain whatever is in flight before switching modes
+    stop_worker();
+    async_ = value;
+    queue_depth_ = std::max<uint64_t>(queue_depth, 1);
+    num_workers_ = std::max<uint64_t>(num_workers, 1);
+}
+
+bool Serializer::finalize() {
+    stop_worker();
+    std::lock_guard guard(outputs_mutex_);
+    if (outputs_.empty()) return ok();
+    for (auto const &[ptr, output] : outputs_) {
+        if (output->writer && !output->writer->Close().ok()) has_error_ = true;
+    }
+    std::vector<const SerializationStat *> stats;
+    stats.reserve(outputs_.size());
+    for (auto const &[ptr, output] : outputs_) {
+        stats.emplace_back(&output->stat);
     }
 
-    // write out checkpoint file
-    write_checkpoint_file();
+    write_manifest(stats);
+    // files from an earlier finalize are kept from now on
+    append_manifest_ = true;
 
-    writers_.clear();
-    stats_.clear();
+    outputs_.clear();
+    return ok();
 }
 
 bool Serializer::ok() const { return fs_ != nullptr && !has_error_; }
@@ -144,29 +289,43 @@ bool Serializer::set_output_dir(const FileSystemInfo &info) {
     return true;
 }
 
+std::string Serializer::get_manifest_filename(const std::string &dir) {
+    return fmt::format("{0}/{1}", dir, "manifest.json");
+}
+
 std::string Serializer::get_checkpoint_filename(const std::string &dir) {
     return fmt::format("{0}/{1}", dir, "checkpoint.json");
 }
 
-std::pair<std::string, std::string> Serializer::get_next_filename() {
+std::string Serializer::get_next_filename() {
     std::lock_guard guard(batch_mutex_);
     uint64_t id = batch_counter_++;
     auto parquet_name = fmt::format("{0}.parquet", id);
-    auto json_name = fmt::format("{0}.json", id);
     auto dir = fs::path(output_dir_.path);
-    parquet_name = dir / parquet_name;
-    json_name = dir / json_name;
-    return {parquet_name, json_name};
+    return dir / parquet_name;
 }
 
-parquet::arrow::FileWriter *Serializer::get_writer(const void *ptr,
+Serializer::SerializationOutput *Serializer::get_output(const void *ptr) {
+    std::lock_guard guard(outputs_mutex_);
+    auto it = outputs_.find(ptr);
+    if (it != outputs_.end()) {
+        return it->second.get();
+    }
+
+    auto output = std::make_unique<SerializationOutput>();
+    output->stat.parquet_filename = get_next_filename();
+    auto *result = output.get();
+    outputs_.emplace(ptr, std::move(output));
+    return result;
+}
+
+parquet::arrow::FileWriter *Serializer::get_writer(SerializationOutput *output,
                                                    const std::shared_ptr<arrow::Schema> &schema) {
-    if (writers_.find(ptr) != writers_.end()) {
-        return writers_.at(ptr).get();
+    if (output->writer) {
+        return output->writer.get();
     } else {
         // need to create a new set of files
-        auto &stat = get_stat(ptr);
-        auto res_f = fs_->OpenOutputStream(stat.parquet_filename);
+        auto res_f = fs_->OpenOutputStream(output->stat.parquet_filename);
         if (!res_f.ok()) return nullptr;
         auto out_file = *res_f;
 
@@ -176,31 +335,17 @@ parquet::arrow::FileWriter *Serializer::get_writer(const void *ptr,
             parquet::default_arrow_writer_properties(), &writer);
         if (!res.ok()) return nullptr;
         // transfer ownership
-        std::shared_ptr<parquet::arrow::FileWriter> writer_ptr = std::move(writer);
-        writers_.emplace(ptr, writer_ptr);
-        return writer_ptr.get();
+        output->writer = std::move(writer);
+        return output->writer.get();
     }
 }
 
-SerializationStat &Serializer::get_stat(const void *ptr) {
-    if (stats_.find(ptr) != stats_.end()) {
-        return stats_.at(ptr);
-    }
-
-    auto [parquet_name, json_name] = get_next_filename();
-    auto &stat = stats_[ptr];
-    stat.parquet_filename = parquet_name;
-    stat.json_filename = json_name;
-
-    return stat;
-}
-
 void Serializer::identify_batch_counter() {
     while (true) {
-        auto json_name = fmt::format("{0}.json", batch_counter_);
+        auto parquet_name = fmt::format("{0}.parquet", batch_counter_);
         auto dir = fs::path(output_dir_.path);
-        json_name = dir / json_name;
-        if (exists(fs_, json_name)) {
+        parquet_name = dir / parquet_name;
+        if (exists(fs_, parquet_name)) {
             batch_counter_++;
         } else {
             break;
@@ -227,8 +372,9 @@ bool Serializer::serialize(parquet::arrow::FileWriter *writer,
 
 void write_json_to_file(const std::shared_ptr<arrow::fs::FileSystem> &fs,
                         rapidjson::Document &document, const std::string &filename) {
+    // the manifest can list tens of thousands of files, so we keep it compact
     rapidjson::StringBuffer buffer;
-    rapidjson::PrettyWriter w(buffer);
+    rapidjson::Writer w(buffer);
     document.Accept(w);
     auto const *s = buffer.GetString();
 
@@ -239,51 +385,130 @@ void write_json_to_file(const std::shared_ptr<arrow::fs::FileSystem> &fs,
     (void)file->Close();
 }
 
+template <typename T, typename F>
+void add_range(RowGroupStat &stat, const char *name, const T &batch, F get_value) {
+    if (batch.empty()) return;
+    auto min = std::numeric_limits<uint64_t>::max();
+    uint64_t max = 0;
+    for (auto const &entry : batch) {
+        auto value = get_value(*entry);
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    stat.ranges.emplace(name, std::make_pair(min, max));
+}
+
 void Serializer::update_stat(SerializationStat &stat, const EventBatch &batch) {
     if (stat.type.empty()) stat.type = "event";
     if (stat.name.empty() && !batch.name().empty()) {
         stat.name = batch.name();
     }
+    auto &row_group = stat.row_groups.emplace_back();
+    row_group.num_rows = batch.size();
+    add_range(row_group, Event::TIME_NAME, batch, [](const Event &e) { return e.time(); });
+    add_range(row_group, Event::ID_NAME, batch, [](const Event &e) { return e.id(); });
 }
 
-void Serializer::update_stat(SerializationStat &stat, const TransactionBatch &batch) {
-    if (stat.type.empty()) stat.type = "transaction";
+template <typename T>
+void update_transaction_stat(SerializationStat &stat, const T &batch) {
     if (stat.name.empty() && !batch.name().empty()) {
         stat.name = batch.name();
     }
+    auto &row_group = stat.row_groups.emplace_back();
+    row_group.num_rows = batch.size();
+    using Value = typename std::remove_reference<decltype(*batch.front())>::type;
+    add_range(row_group, Transaction::START_TIME_NAME, batch,
+              [](const Value &t) { return t.start_time(); });
+    add_range(row_group, Transaction::END_TIME_NAME, batch,
+              [](const Value &t) { return t.end_time(); });
+    add_range(row_group, Transaction::ID_NAME, batch, [](const Value &t) { return t.id(); });
+}
+
+void Serializer::update_stat(SerializationStat &stat, const TransactionBatch &batch) {
+    if (stat.type.empty()) stat.type = "transaction";
+    update_transaction_stat(stat, batch);
 }
 
 void Serializer::update_stat(SerializationStat &stat, const TransactionGroupBatch &batch) {
     if (stat.type.empty()) stat.type = "transaction-group";
-    if (stat.name.empty() && !batch.name().empty()) {
-        stat.name = batch.name();
-    }
+    update_transaction_stat(stat, batch);
 }
 
-void Serializer::write_stat(const std::shared_ptr<arrow::fs::FileSystem> &fs,
-                            const SerializationStat &stat) {
+void Serializer::write_manifest(const std::vector<const SerializationStat *> &stats) {
     rapidjson::Document document(rapidjson::kObjectType);
-    auto parquet_basename = std::string(fs::path(stat.parquet_filename).filename());
-    json::set_member(document, "parquet", parquet_basename);
-    json::set_member(document, "type", stat.type);
-    json::set_member(document, "name", stat.name);
+    auto &allocator = document.GetAllocator();
+    rapidjson::Value files(rapidjson::kArrayType);
 
-    write_json_to_file(fs, document, stat.json_filename);
-}
+    std::unordered_set<std::string> parquet_names;
+    for (auto const *stat : stats) {
+        parquet_names.emplace(fs::path(stat->parquet_filename).filename());
+    }
+
+    auto filename = get_manifest_filename(output_dir_.path);
+    // keep the entries written by previous serializers, unless we overwrote that file
+    if (append_manifest_) {
+        rapidjson::Document old_document;
+        auto content = read_file(fs_, filename);
+        if (content) old_document.Parse(content->c_str());
+        if (content && !old_document.HasParseError() && old_document.HasMember("files") &&
+            old_document["files"].IsArray()) {
+            for (auto &entry : old_document["files"].GetArray()) {
+                if (!entry.IsObject() || !entry.HasMember("parquet") ||
+                    !entry["parquet"].IsString())
+                    continue;
+                if (parquet_names.find(entry["parquet"].GetString()) != parquet_names.end())
+                    continue;
+                rapidjson::Value value(entry, allocator);
+                files.PushBack(value, allocator);
+            }
+        }
+    } else {
+        // the loader reads the checkpoint next to the manifest, so files from an older run
+        // would come back
+        auto checkpoint_filename = get_checkpoint_filename(output_dir_.path);
+        if (exists(fs_, checkpoint_filename)) (void)fs_->DeleteFile(checkpoint_filename);
+    }
 
-void Serializer::write_checkpoint_file() {
-    if (batch_counter_ == 0) return;
+    for (auto const *stat : stats) {
+        rapidjson::Value entry(rapidjson::kObjectType);
+        auto parquet_basename = std::string(fs::path(stat->parquet_filename).filename());
+        json::set_member(entry, allocator, "parquet", parquet_basename);
+        json::set_member(entry, allocator, "type", stat->type);
+        json::set_member(entry, allocator, "name", stat->name);
+        uint64_t size = 0;
+        auto info_res = fs_->GetFileInfo(stat->parquet_filename);
+        if (info_res.ok() && info_res->size() > 0) size = info_res->size();
+        json::set_member(entry, allocator, "size", size);
+
+        // column types are enough to estimate the memory usage and to report the schema
+        rapidjson::Value schema(rapidjson::kObjectType);
+        if (stat->schema) {
+            for (auto const &field : stat->schema->fields()) {
+                json::set_member(schema, allocator, field->name().c_str(),
+                                 field->type()->ToString());
+            }
+        }
+        json::set_member(entry, allocator, "schema", schema);
+
+        rapidjson::Value row_groups(rapidjson::kArrayType);
+        for (auto const &row_group : stat->row_groups) {
+            rapidjson::Value group(rapidjson::kObjectType);
+            json::set_member(group, allocator, "num_rows", row_group.num_rows);
+            for (auto const &[name, range] : row_group.ranges) {
+                rapidjson::Value value(rapidjson::kArrayType);
+                value.PushBack(range.first, allocator);
+                value.PushBack(range.second, allocator);
+                json::set_member(group, allocator, name.c_str(), value);
+            }
+            row_groups.PushBack(group, allocator);
+        }
+        json::set_member(entry, allocator, "row_groups", row_groups);
 
-    rapidjson::Document document(rapidjson::kObjectType);
-    rapidjson::Value array(rapidjson::kArrayType);
-    // write out all the json files we have
-    // we use batch counter as a way to do stuff
-    auto filename = get_checkpoint_filename(output_dir_.path);
-    for (uint64_t i = 0; i < batch_counter_; i++) {
-        rapidjson::Value v(fmt::format("{0}.json", i).c_str(), document.GetAllocator());
-        array.PushBack(std::move(v), document.GetAllocator());
+        files.PushBack(entry, allocator);
     }
-    document.AddMember("files", array, document.GetAllocator());
+
+    json::set_member(document, "version", MANIFEST_VERSION);
+    document.AddMember("files", files, allocator);
 
     write_json_to_file(fs_, document, filename);
 }
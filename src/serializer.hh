@@ -1,8 +1,15 @@
 #ifndef HERMES_SERIALIZER_HH
 #define HERMES_SERIALIZER_HH
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
 #include <mutex>
+#include <optional>
+#include <thread>
 #include <unordered_set>
+#include <variant>
 
 #include "arrow.hh"
 #include "event.hh"
@@ -27,14 +34,42 @@ class RandomAccessFile;
 
 namespace hermes {
 
+// each serialized batch becomes one row group
+struct RowGroupStat {
+    uint64_t num_rows = 0;
+    // min/max of the indexed columns, e.g. time and id for events
+    std::map<std::string, std::pair<uint64_t, uint64_t>> ranges;
+};
+
 struct SerializationStat {
     std::string parquet_filename;
-    std::string json_filename;
 
     std::string type;
 
     // could be empty
     std::string name;
+
+    std::shared_ptr<arrow::Schema> schema;
+    std::vector<RowGroupStat> row_groups;
+};
+
+enum class CompressionCodec { none, snappy, lz4, zstd };
+
+struct CompressionOption {
+    CompressionCodec codec = CompressionCodec::snappy;
+    // codec specific level, e.g. 1-22 for zstd. use the codec default if not set
+    std::optional<int> level;
+};
+
+struct SerializerOptions {
+    CompressionOption compression;
+    // per-column overrides
+    std::map<std::string, CompressionOption> column_compression;
+    // every value in a monotonic column is unique, so dictionary encoding never pays off
+    std::unordered_set<std::string> monotonic_columns = {"time", "id", "start_time", "end_time"};
+    // dictionary encoding for the remaining columns, such as name and other
+    // low-cardinality strings
+    bool dictionary_encoding = true;
 };
 
 class Serializer {
@@ -43,45 +78,107 @@ public:
     Serializer(const std::string &output_dir, bool override);
     Serializer(FileSystemInfo info, bool override);
 
+    // these can be called concurrently from different threads as long as each thread
+    // uses its own batches. each batch maps to its own output file
     bool serialize(EventBatch &batch);
     bool serialize(TransactionBatch &batch);
     bool serialize(TransactionGroupBatch &batch);
 
-    void finalize();
+    // flushes all queued batches before closing the files. returns false if any batch,
+    // including the ones written in the background, failed to serialize
+    bool finalize();
     // whether the serializer is in a good state
     [[nodiscard]] bool ok() const;
+
     bool set_output_dir(const FileSystemInfo &info);
     bool set_output_dir(const std::string &path) { return set_output_dir(FileSystemInfo(path)); }
 
+    // only affects files opened after this call. returns false if a codec is not available
+    bool set_options(const SerializerOptions &options);
+    [[nodiscard]] const SerializerOptions &options() const { return options_; }
+
+    // in async mode the content of a batch is moved onto a bounded queue and written by
+    // background workers, leaving the caller's batch empty. serialize() only blocks when
+    // the queue is full. batches from the same source are always written in order
+    void set_async(bool value, uint64_t queue_depth = default_queue_depth,
+                   uint64_t num_workers = 1);
+    [[nodiscard]] bool async() const { return async_; }
+    static constexpr uint64_t default_queue_depth = 4;
+
     ~Serializer() { finalize(); }
 
+    // a single manifest describes every parquet file in the directory so that
+    // the loader can plan queries without reading any footer
+    static std::string get_manifest_filename(const std::string &dir);
+    // lists the per-file json of the layout used before the manifest
     static std::string get_checkpoint_filename(const std::string &dir);
+    static constexpr auto MANIFEST_VERSION = 1;
 
 private:
+    struct SerializationTask {
+        // batches are keyed by the address of the caller's batch so that
+        // each one still maps to a single file
+        const void *key;
+        std::variant<std::shared_ptr<EventBatch>, std::shared_ptr<TransactionBatch>,
+                     std::shared_ptr<TransactionGroupBatch>>
+            batch;
+    };
+
+    // one output file per batch source. the writer is only touched under its own lock
+    struct SerializationOutput {
+        std::mutex mutex;
+        std::shared_ptr<parquet::arrow::FileWriter> writer;
+        SerializationStat stat;
+    };
+
     FileSystemInfo output_dir_;
     uint64_t batch_counter_ = 0;
     std::mutex batch_mutex_;
+    SerializerOptions options_;
     std::shared_ptr<parquet::WriterProperties> writer_properties_;
-    std::unordered_map<const void *, std::shared_ptr<parquet::arrow::FileWriter>> writers_;
-    std::unordered_map<const void *, SerializationStat> stats_;
+    std::mutex outputs_mutex_;
+    std::unordered_map<const void *, std::unique_ptr<SerializationOutput>> outputs_;
     // file system implementation from arrow
     std::shared_ptr<arrow::fs::FileSystem> fs_;
-    bool has_error_ = false;
-
-    std::pair<std::string, std::string> get_next_filename();
-    parquet::arrow::FileWriter *get_writer(const void *ptr,
+    // sticky, so that failed background writes are reported by later calls
+    std::atomic<bool> has_error_ = false;
+    // whether existing manifest entries should be kept when writing the manifest
+    bool append_manifest_ = false;
+
+    // async mode
+    std::atomic<bool> async_ = false;
+    uint64_t queue_depth_ = default_queue_depth;
+    std::mutex queue_mutex_;
+    std::condition_variable queue_cond_;
+    std::deque<SerializationTask> queue_;
+    bool stop_worker_ = false;
+    uint64_t num_workers_ = 1;
+    std::vector<std::thread> workers_;
+    // sources that currently have a batch being written by a worker
+    std::unordered_set<const void *> busy_keys_;
+
+    std::string get_next_filename();
+    SerializationOutput *get_output(const void *ptr);
+    parquet::arrow::FileWriter *get_writer(SerializationOutput *output,
                                            const std::shared_ptr<arrow::Schema> &schema);
-    SerializationStat &get_stat(const void *ptr);
     void identify_batch_counter();
 
+    bool write(const void *key, EventBatch &batch);
+    bool write(const void *key, TransactionBatch &batch);
+    bool write(const void *key, TransactionGroupBatch &batch);
+    template <typename T>
+    bool write_batch(const void *key, const T &batch);
+    template <typename T>
+    bool enqueue(T &batch);
+    void process_queue();
+    void stop_worker();
+
     static bool serialize(parquet::arrow::FileWriter *writer,
                           const std::shared_ptr<arrow::RecordBatch> &record);
     static void update_stat(SerializationStat &stat, const EventBatch &batch);
     static void update_stat(SerializationStat &stat, const TransactionBatch &batch);
     static void update_stat(SerializationStat &stat, const TransactionGroupBatch &batch);
-    static void write_stat(const std::shared_ptr<arrow::fs::FileSystem> &fs,
-                           const SerializationStat &stat);
-    void write_checkpoint_file();
+    void write_manifest(const std::vector<const SerializationStat *> &stats);
 };
 
 }  // namespace hermes
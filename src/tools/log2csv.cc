@@ -74,9 +74,11 @@ int main(int argc, char *argv[]) {
     auto const &tables = loader.tables();
     std::unordered_map<std::string, std::unique_ptr<std::ofstream>> writers;
     std::unordered_map<std::string, std::vector<std::string>> headers;
-    for (auto const &[info, table] : tables) {
+    for (auto const &[info, row_group] : tables) {
         auto const *file = info.first;
         auto name = file->name;
+        auto table = loader.load_table(row_group.get());
+        if (!table) continue;
         if (writers.find(name) == writers.end()) {
             auto filename = get_filename(output_dir, file->name);
             auto stream = std::make_unique<std::ofstream>(filename);
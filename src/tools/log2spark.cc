@@ -128,9 +128,11 @@ int main(int argc, char *argv[]) {  // NOLINT
     // we just open up the files and try to convert the schema and
     auto const &tables = loader.tables();
     std::unordered_map<std::string, std::unique_ptr<parquet::arrow::FileWriter>> writers_;
-    for (auto const &[info, table] : tables) {
+    for (auto const &[info, row_group] : tables) {
         auto const *file = info.first;
         auto name = file->filename;
+        auto table = loader.load_table(row_group.get());
+        if (!table) continue;
         auto base_name = fs::path(name).filename();
         auto output_filename = fs::path(output_dir) / base_name;
 
@@ -3,6 +3,7 @@
 
 #include <unordered_set>
 
+#include "pool.hh"
 #include "pubsub.hh"
 #include "serializer.hh"
 #include "transaction.hh"
@@ -48,7 +49,7 @@ public:
 
     TransactionObject *get_new_transaction() {
         // we use the default id allocator
-        auto t = std::make_shared<TransactionObject>();
+        auto t = make_pooled<TransactionObject>();
         auto *ptr = t.get();
         inflight_transactions.emplace(t);
         t->set_name(transaction_name_);
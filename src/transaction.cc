@@ -4,15 +4,17 @@
 #include "arrow/api.h"
 #include "arrow/ipc/reader.h"
 #include "parquet/stream_writer.h"
+#include "pool.hh"
+#include "search.hh"
 
 namespace hermes {
 
-std::atomic<uint64_t> Transaction::id_allocator_ = 0;
+IdAllocator Transaction::id_allocator_;
 
 const std::unordered_set<std::string> Transaction::reserved_attr_names = {
     ID_NAME, START_TIME_NAME, END_TIME_NAME, FINISHED_NAME, NAME_NAME, EVENTS_NAME};
 
-Transaction::Transaction() noexcept : id_(id_allocator_++) {}
+Transaction::Transaction() noexcept : id_(id_allocator_.next()) {}
 
 bool Transaction::add_event(const Event *event) {
     if (finished_) return false;
@@ -52,19 +54,31 @@ TransactionBatch::serialize() const noexcept {
     auto &event_ids_builder =
         *(reinterpret_cast<arrow::UInt64Builder *>(event_ids_list_builder.value_builder()));
 
+    // exact reserves so that the builders never have to grow
+    auto const num_rows = static_cast<int64_t>(size());
+    int64_t num_names = 0, num_event_ids = 0;
     for (auto const &transaction : list) {
-        (void)id_builder.Append(transaction->id());
-        (void)start_builder.Append(transaction->start_time());
-        (void)end_builder.Append(transaction->end_time());
-        (void)name_builder.Append(transaction->name());
-        (void)finished_builder.Append(transaction->finished());
-        std::vector<uint64_t> ids;
+        num_names += static_cast<int64_t>(transaction->name().size());
+        num_event_ids += static_cast<int64_t>(transaction->events().size());
+    }
+    if (!id_builder.Reserve(num_rows).ok() || !start_builder.Reserve(num_rows).ok() ||
+        !end_builder.Reserve(num_rows).ok() || !name_builder.Reserve(num_rows).ok() ||
+        !name_builder.ReserveData(num_names).ok() || !finished_builder.Reserve(num_rows).ok() ||
+        !event_ids_list_builder.Reserve(num_rows).ok() ||
+        !event_ids_builder.Reserve(num_event_ids).ok()) {
+        return error_return;
+    }
+
+    for (auto const &transaction : list) {
+        id_builder.UnsafeAppend(transaction->id());
+        start_builder.UnsafeAppend(transaction->start_time());
+        end_builder.UnsafeAppend(transaction->end_time());
+        name_builder.UnsafeAppend(transaction->name());
+        finished_builder.UnsafeAppend(transaction->finished());
         auto const &events = transaction->events();
-        ids.reserve(events.size());
-        for (auto const &id : events) ids.emplace_back(id);
         // indicate the start of a new list row
         (void)event_ids_list_builder.Append();
-        (void)event_ids_builder.AppendValues(ids.data(), static_cast<int64_t>(ids.size()));
+        (void)event_ids_builder.AppendValues(events.data(), static_cast<int64_t>(events.size()));
     }
     std::shared_ptr<arrow::Array> id_array;
     auto r = id_builder.Finish(&id_array);
@@ -118,23 +132,28 @@ std::unique_ptr<TransactionBatch> TransactionBatch::deserialize(const arrow::Tab
 
     // need to iterate over the chunks
     for (auto idx = 0; idx < id->num_chunks(); idx++) {
-        auto id_column = id->chunk(idx);
-        auto start_time = start->chunk(idx);
-        auto end_time = end->chunk(idx);
-        auto name_ = name->chunk(idx);
-        auto finished_ = finished->chunk(idx);
-        auto events = e->chunk(idx);
+        std::vector<uint64_t> ids, start_times, end_times;
+        std::vector<std::string> names;
+        std::vector<bool> finished_values;
+        std::vector<std::vector<uint64_t>> event_ids;
+        if (!decode_uint64s(id->chunk(idx).get(), ids) ||
+            !decode_uint64s(start->chunk(idx).get(), start_times) ||
+            !decode_uint64s(end->chunk(idx).get(), end_times) ||
+            !decode_strings(name->chunk(idx).get(), names) ||
+            !decode_bools(finished->chunk(idx).get(), finished_values) ||
+            !decode_uint64_lists(e->chunk(idx).get(), event_ids)) {
+            throw std::runtime_error("Invalid transaction table schema");
+        }
 
-        for (auto i = 0; i < id_column->length(); i++) {
-            auto tid = get_uint64(*id_column->GetScalar(i));
-            auto transaction = std::make_unique<Transaction>(tid);
+        for (auto i = 0u; i < ids.size(); i++) {
+            auto transaction = make_pooled<Transaction>(ids[i]);
 
-            transaction->start_time_ = get_uint64(*start_time->GetScalar(i));
-            transaction->end_time_ = get_uint64(*end_time->GetScalar(i));
-            transaction->name_ = get_string(*name_->GetScalar(i));
-            transaction->finished_ = get_bool(*finished_->GetScalar(i));
+            transaction->start_time_ = start_times[i];
+            transaction->end_time_ = end_times[i];
+            transaction->name_ = std::move(names[i]);
+            transaction->finished_ = finished_values[i];
 
-            transaction->events_ids_ = get_uint64s(*events->GetScalar(i));
+            transaction->events_ids_ = std::move(event_ids[i]);
 
             transactions->emplace_back(std::move(transaction));
         }
@@ -153,16 +172,11 @@ std::unique_ptr<TransactionBatch> TransactionBatch::deserialize(const arrow::Tab
 }
 
 TransactionBatch::iterator TransactionBatch::lower_bound(uint64_t time) {
-    if (time_lower_bound_.empty()) {
+    if (time_index_.size() != size()) {
         build_time_index();
     }
-
-    auto it = time_lower_bound_.lower_bound(time);
-    if (it == time_lower_bound_.end()) {
-        return end();
-    } else {
-        return it->second;
-    }
+    auto index = branchless_lower_bound(time_index_.data(), time_index_.size(), time);
+    return begin() + static_cast<int64_t>(index);
 }
 
 bool TransactionBatch::validate() const noexcept {
@@ -178,9 +192,9 @@ bool TransactionBatch::validate() const noexcept {
 
 void TransactionBatch::build_time_index() {
     // we assume the transaction is sorted by end time already
-    for (auto it = begin(); it != end(); it++) {
-        auto const &transaction = *it;
-        time_lower_bound_.try_emplace(transaction->end_time_, it);
+    time_index_.resize(size());
+    for (uint64_t i = 0; i < size(); i++) {
+        time_index_[i] = (*this)[i]->end_time_;
     }
 }
 
@@ -192,6 +206,23 @@ void TransactionBatch::build_id_index() {
     }
 }
 
+void TransactionBatch::clear_index() {
+    id_index_.clear();
+    time_index_.clear();
+}
+
+uint64_t TransactionBatch::memory_size() const {
+    constexpr uint64_t transaction_size =
+        sizeof(Transaction) + sizeof(std::shared_ptr<Transaction>);
+    uint64_t result = sizeof(TransactionBatch) + size() * sizeof(std::shared_ptr<Transaction>);
+    for (auto const &t : *this) {
+        result += transaction_size + t->events_ids_.capacity() * sizeof(uint64_t) +
+                  hermes::memory_size(t->name_) + hermes::memory_size(t->attrs_);
+    }
+    result += hermes::memory_size(id_index_) + time_index_.capacity() * sizeof(uint64_t);
+    return result;
+}
+
 bool TransactionBatch::contains(uint64_t id) {
     if (id_index_.empty()) {
         build_id_index();
@@ -212,11 +243,11 @@ void TransactionBatch::sort() {
                      [](const auto &a, const auto &b) { return a->end_time() < b->end_time(); });
 }
 
-std::atomic<uint64_t> TransactionGroup::id_allocator_ = 0;
+IdAllocator TransactionGroup::id_allocator_;
 
 TransactionGroup::TransactionGroup(uint64_t id) : id_(id) {}
 
-TransactionGroup::TransactionGroup() : TransactionGroup(id_allocator_++) {}
+TransactionGroup::TransactionGroup() : TransactionGroup(id_allocator_.next()) {}
 
 void TransactionGroup::add_transaction(const std::shared_ptr<TransactionGroup> &group) {
     transactions_.emplace_back(group->id());
@@ -268,12 +299,26 @@ TransactionGroupBatch::serialize() const noexcept {
     auto &transaction_masks_builder =
         *(reinterpret_cast<arrow::BooleanBuilder *>(transaction_mask_list_builder.value_builder()));
 
+    auto const num_rows = static_cast<int64_t>(size());
+    int64_t num_names = 0, num_ids = 0;
     for (auto const &transaction : list) {
-        (void)id_builder.Append(transaction->id());
-        (void)start_builder.Append(transaction->start_time());
-        (void)end_builder.Append(transaction->end_time());
-        (void)name_builder.Append(transaction->name());
-        (void)finished_builder.Append(transaction->finished());
+        num_names += static_cast<int64_t>(transaction->name().size());
+        num_ids += static_cast<int64_t>(transaction->transactions().size());
+    }
+    if (!id_builder.Reserve(num_rows).ok() || !start_builder.Reserve(num_rows).ok() ||
+        !end_builder.Reserve(num_rows).ok() || !name_builder.Reserve(num_rows).ok() ||
+        !name_builder.ReserveData(num_names).ok() || !finished_builder.Reserve(num_rows).ok() ||
+        !transaction_ids_builder.Reserve(num_ids).ok() ||
+        !transaction_masks_builder.Reserve(num_ids).ok()) {
+        return error_return;
+    }
+
+    for (auto const &transaction : list) {
+        id_builder.UnsafeAppend(transaction->id());
+        start_builder.UnsafeAppend(transaction->start_time());
+        end_builder.UnsafeAppend(transaction->end_time());
+        name_builder.UnsafeAppend(transaction->name());
+        finished_builder.UnsafeAppend(transaction->finished());
         // indicate the start of a new list row
         (void)transaction_ids_list_builder.Append();
         (void)transaction_mask_list_builder.Append();
@@ -336,25 +381,31 @@ std::unique_ptr<TransactionGroupBatch> TransactionGroupBatch::deserialize(  // N
 
     // need to iterate over the chunks
     for (auto idx = 0; idx < id->num_chunks(); idx++) {
-        auto id_column = id->chunk(idx);
-        auto start_time = start->chunk(idx);
-        auto end_time = end->chunk(idx);
-        auto name_ = names->chunk(idx);
-        auto finished_ = finished->chunk(idx);
-        auto ids_ = ids->chunk(idx);
-        auto masks_ = masks->chunk(idx);
-
-        for (auto i = 0; i < id_column->length(); i++) {
-            auto tid = get_uint64(*id_column->GetScalar(i));
-            auto transaction = std::make_unique<TransactionGroup>(tid);
-
-            transaction->start_time_ = get_uint64(*start_time->GetScalar(i));
-            transaction->end_time_ = get_uint64(*end_time->GetScalar(i));
-            transaction->name_ = get_string(*name_->GetScalar(i));
-            transaction->finished_ = get_bool(*finished_->GetScalar(i));
-
-            transaction->transactions_ = get_uint64s(*ids_->GetScalar(i));
-            transaction->transaction_masks_ = get_bools(*masks_->GetScalar(i));
+        std::vector<uint64_t> group_ids, start_times, end_times;
+        std::vector<std::string> group_names;
+        std::vector<bool> finished_values;
+        std::vector<std::vector<uint64_t>> transaction_ids;
+        std::vector<std::vector<bool>> transaction_masks;
+        if (!decode_uint64s(id->chunk(idx).get(), group_ids) ||
+            !decode_uint64s(start->chunk(idx).get(), start_times) ||
+            !decode_uint64s(end->chunk(idx).get(), end_times) ||
+            !decode_strings(names->chunk(idx).get(), group_names) ||
+            !decode_bools(finished->chunk(idx).get(), finished_values) ||
+            !decode_uint64_lists(ids->chunk(idx).get(), transaction_ids) ||
+            !decode_bool_lists(masks->chunk(idx).get(), transaction_masks)) {
+            throw std::runtime_error("Invalid transaction group table schema");
+        }
+
+        for (auto i = 0u; i < group_ids.size(); i++) {
+            auto transaction = make_pooled<TransactionGroup>(group_ids[i]);
+
+            transaction->start_time_ = start_times[i];
+            transaction->end_time_ = end_times[i];
+            transaction->name_ = std::move(group_names[i]);
+            transaction->finished_ = finished_values[i];
+
+            transaction->transactions_ = std::move(transaction_ids[i]);
+            transaction->transaction_masks_ = std::move(transaction_masks[i]);
 
             transactions->emplace_back(std::move(transaction));
         }
@@ -382,10 +433,26 @@ std::shared_ptr<TransactionGroup> TransactionGroupBatch::at(uint64_t id) {
         return id_index_.at(id)->shared_from_this();
 }
 
+uint64_t TransactionGroupBatch::memory_size() const {
+    constexpr uint64_t group_size =
+        sizeof(TransactionGroup) + sizeof(std::shared_ptr<TransactionGroup>);
+    uint64_t result =
+        sizeof(TransactionGroupBatch) + size() * sizeof(std::shared_ptr<TransactionGroup>);
+    for (auto const &g : *this) {
+        // masks are packed bits
+        result += group_size + g->transactions_.capacity() * sizeof(uint64_t) +
+                  g->transaction_masks_.capacity() / 8 + hermes::memory_size(g->name_);
+    }
+    result += hermes::memory_size(id_index_);
+    return result;
+}
+
 void TransactionGroupBatch::build_index() {
     for (auto const &t : *this) {
         id_index_.emplace(t->id(), t.get());
     }
 }
 
+void TransactionGroupBatch::clear_index() { id_index_.clear(); }
+
 }  // namespace hermes
\ No newline at end of file
@@ -58,7 +58,7 @@ public:
             return std::get<T>(attrs_.at(name));
     }
 
-    void static reset_id() { id_allocator_ = 0; }
+    void static reset_id() { id_allocator_.reset(); }
 
 private:
     uint64_t id_;
@@ -68,7 +68,7 @@ private:
     bool finished_ = false;
     std::vector<uint64_t> events_ids_;
 
-    static std::atomic<uint64_t> id_allocator_;
+    static IdAllocator id_allocator_;
 
     std::map<std::string, AttributeValue> attrs_;
 
@@ -97,9 +97,15 @@ public:
     void build_time_index();
     void build_id_index();
 
+    // estimated resident bytes, including all the transactions
+    [[nodiscard]] uint64_t memory_size() const;
+
 private:
     std::unordered_map<uint64_t, Transaction *> id_index_;
-    std::map<uint64_t, TransactionBatch::iterator> time_lower_bound_;
+    // end times in batch order, searched by lower_bound
+    std::vector<uint64_t> time_index_;
+
+    void clear_index() override;
 };
 
 class TransactionGroupBatch;
@@ -128,7 +134,7 @@ public:
         on_finished_ = func;
     }
 
-    void static reset_id() { id_allocator_ = 0; }
+    void static reset_id() { id_allocator_.reset(); }
 
 private:
     uint64_t id_;
@@ -143,7 +149,7 @@ private:
     // callback for trackers
     std::optional<std::function<void(TransactionGroup *)>> on_finished_;
 
-    static std::atomic<uint64_t> id_allocator_;
+    static IdAllocator id_allocator_;
 
     friend class TransactionGroupBatch;
 };
@@ -162,8 +168,13 @@ public:
 
     void build_index();
 
+    // estimated resident bytes, including all the groups
+    [[nodiscard]] uint64_t memory_size() const;
+
 private:
     std::unordered_map<uint64_t, TransactionGroup *> id_index_;
+
+    void clear_index() override;
 };
 
 }  // namespace hermes
@@ -0,0 +1,95 @@
+#include <random>
+#include <set>
+
+#include "bitmap.hh"
+#include "gtest/gtest.h"
+
+// sparse values, a dense block and a long run, so that every container kind is used
+std::set<uint64_t> get_values() {
+    std::set<uint64_t> values;
+    std::mt19937_64 rng(42);  // NOLINT
+    for (auto i = 0; i < 1000; i++) values.emplace(rng() % (1u << 20u));
+    for (uint64_t i = 1u << 21u; i < (1u << 21u) + 20000; i++) {
+        if (rng() % 2) values.emplace(i);
+    }
+    for (uint64_t i = 1u << 22u; i < (1u << 22u) + 100000; i++) values.emplace(i);
+    return values;
+}
+
+void check_bitmap(const hermes::RowBitmap &bitmap, const std::set<uint64_t> &values) {
+    EXPECT_EQ(bitmap.size(), values.size());
+    std::vector<uint64_t> result(bitmap.begin(), bitmap.end());
+    std::vector<uint64_t> expected(values.begin(), values.end());
+    EXPECT_EQ(result, expected);
+    for (uint64_t i = 0; i < expected.size(); i += 97) {
+        EXPECT_EQ(bitmap.select(i), expected[i]);
+        EXPECT_TRUE(bitmap.contains(expected[i]));
+        // iteration can start at any rank
+        auto it = bitmap.at(i);
+        for (uint64_t j = i; j < std::min<uint64_t>(i + 3, expected.size()); j++, ++it) {
+            EXPECT_EQ(*it, expected[j]);
+        }
+    }
+    EXPECT_EQ(bitmap.at(expected.size()), bitmap.end());
+}
+
+TEST(bitmap, add) {  // NOLINT
+    auto values = get_values();
+    hermes::RowBitmap bitmap;
+    for (auto v : values) bitmap.add(v);
+    check_bitmap(bitmap, values);
+    EXPECT_FALSE(bitmap.contains(1u << 23u));
+
+    // out of order and duplicated values
+    hermes::RowBitmap reversed;
+    for (auto it = values.rbegin(); it != values.rend(); it++) reversed.add(*it);
+    reversed.add(*values.begin());
+    check_bitmap(reversed, values);
+
+    auto size = bitmap.memory_size();
+    bitmap.optimize();
+    check_bitmap(bitmap, values);
+    // the long run collapses
+    EXPECT_LT(bitmap.memory_size(), size);
+    EXPECT_LT(bitmap.memory_size(), values.size());
+}
+
+TEST(bitmap, range) {  // NOLINT
+    auto bitmap = hermes::RowBitmap::range(10, 200000);
+    std::set<uint64_t> values;
+    for (uint64_t i = 10; i < 200000; i++) values.emplace(i);
+    check_bitmap(bitmap, values);
+    EXPECT_LT(bitmap.memory_size(), 1024);
+    EXPECT_TRUE(hermes::RowBitmap::range(5, 5).empty());
+}
+
+TEST(bitmap, set_operations) {  // NOLINT
+    auto values = get_values();
+    hermes::RowBitmap a;
+    for (auto v : values) a.add(v);
+    std::set<uint64_t> even;
+    hermes::RowBitmap b;
+    for (uint64_t i = 0; i < (1u << 21u) + 30000; i += 2) {
+        b.add(i);
+        even.emplace(i);
+    }
+
+    std::set<uint64_t> expected;
+    std::set_intersection(values.begin(), values.end(), even.begin(), even.end(),
+                          std::inserter(expected, expected.end()));
+    check_bitmap(a & b, expected);
+
+    expected.clear();
+    std::set_union(values.begin(), values.end(), even.begin(), even.end(),
+                   std::inserter(expected, expected.end()));
+    check_bitmap(a | b, expected);
+
+    // runs against arrays
+    auto range = hermes::RowBitmap::range(1000, 1u << 21u);
+    expected.clear();
+    for (auto v : values) {
+        if (v >= 1000 && v < (1u << 21u)) expected.emplace(v);
+    }
+    check_bitmap(a & range, expected);
+    EXPECT_TRUE((a & hermes::RowBitmap()).empty());
+}
@@ -0,0 +1,252 @@
+#include <chrono>
+#include <thread>
+
+#include "cache.hh"
+#include "gtest/gtest.h"
+
+using Cache = hermes::ShardedCache<uint64_t, std::shared_ptr<uint64_t>>;
+
+TEST(cache, get_put) {  // NOLINT
+    auto budget = std::make_shared<hermes::MemoryBudget>(1000);
+    Cache cache(budget);
+    EXPECT_FALSE(cache.get(1));
+    cache.put(1, std::make_shared<uint64_t>(42), 10);
+    auto value = cache.get(1);
+    EXPECT_TRUE(value);
+    EXPECT_EQ(**value, 42);
+    EXPECT_TRUE(cache.exists(1));
+
+    // replacing an entry does not double count
+    cache.put(1, std::make_shared<uint64_t>(43), 20);
+    EXPECT_EQ(**cache.get(1), 43);
+    EXPECT_EQ(budget->usage(), 20);
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 2);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.entries, 1);
+    EXPECT_EQ(stats.bytes, 20);
+}
+
+TEST(cache, byte_budget) {  // NOLINT
+    auto budget = std::make_shared<hermes::MemoryBudget>(100);
+    // single shard so that the eviction order is the exact lru order
+    Cache cache(budget, 1);
+    cache.put(0, std::make_shared<uint64_t>(0), 40);
+    cache.put(1, std::make_shared<uint64_t>(1), 40);
+    // 0 is now the most recently used one
+    EXPECT_TRUE(cache.get(0));
+    cache.put(2, std::make_shared<uint64_t>(2), 40);
+    EXPECT_TRUE(cache.exists(0));
+    EXPECT_FALSE(cache.exists(1));
+    EXPECT_TRUE(cache.exists(2));
+    EXPECT_EQ(cache.stats().evictions, 1);
+    EXPECT_EQ(budget->usage(), 80);
+
+    // shrinking the budget evicts right away
+    budget->set_capacity(50);
+    EXPECT_EQ(cache.size(), 1);
+    EXPECT_LE(budget->usage(), 50);
+}
+
+TEST(cache, shared_budget) {  // NOLINT
+    auto budget = std::make_shared<hermes::MemoryBudget>(100);
+    Cache a(budget, 1);
+    Cache b(budget, 1);
+    a.put(0, std::make_shared<uint64_t>(0), 60);
+    b.put(0, std::make_shared<uint64_t>(0), 30);
+    // b has to take memory from a once it runs out of its own entries
+    b.put(1, std::make_shared<uint64_t>(1), 30);
+    EXPECT_EQ(a.size(), 0);
+    EXPECT_EQ(b.size(), 2);
+    EXPECT_EQ(budget->usage(), 60);
+    // b evicts its own entries first
+    b.put(2, std::make_shared<uint64_t>(2), 50);
+    EXPECT_FALSE(b.exists(0));
+    EXPECT_LE(budget->usage(), 100);
+}
+
+TEST(cache, concurrent) {  // NOLINT
+    constexpr uint64_t num_threads = 8;
+    constexpr uint64_t num_keys = 1000;
+    constexpr uint64_t entry_size = 100;
+    auto budget = std::make_shared<hermes::MemoryBudget>(num_keys / 4 * entry_size);
+    Cache cache(budget);
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (uint64_t t = 0; t < num_threads; t++) {
+        threads.emplace_back([t, &cache]() {
+            for (uint64_t i = 0; i < num_keys; i++) {
+                auto key = (i * 7 + t * 13) % num_keys;
+                auto value = cache.get(key);
+                if (value) {
+                    EXPECT_EQ(**value, key);
+                } else {
+                    cache.put(key, std::make_shared<uint64_t>(key), entry_size);
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits + stats.misses, num_threads * num_keys);
+    EXPECT_LE(budget->usage(), budget->capacity());
+    EXPECT_EQ(stats.bytes, budget->usage());
+}
+
+TEST(cache, single_flight) {  // NOLINT
+    constexpr uint64_t num_threads = 8;
+    auto budget = std::make_shared<hermes::MemoryBudget>(1000);
+    Cache cache(budget);
+    std::atomic<uint64_t> num_loads = 0;
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+    for (uint64_t t = 0; t < num_threads; t++) {
+        threads.emplace_back([&cache, &num_loads]() {
+            auto value = cache.get_or_load(1, [&num_loads]() -> Cache::LoadResult {
+                num_loads++;
+                // make sure every thread misses
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                return std::make_pair(std::make_shared<uint64_t>(42), 10);
+            });
+            EXPECT_TRUE(value);
+            EXPECT_EQ(**value, 42);
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    EXPECT_EQ(num_loads, 1);
+    EXPECT_EQ(cache.stats().coalesced + 1 + cache.stats().hits, num_threads);
+
+    // failed loads are not cached
+    auto value = cache.get_or_load(2, []() -> Cache::LoadResult { return std::nullopt; });
+    EXPECT_FALSE(value);
+    EXPECT_FALSE(cache.exists(2));
+    // neither are exceptions
+    EXPECT_THROW(cache.get_or_load(2, []() -> Cache::LoadResult { throw std::runtime_error(""); }),
+                 std::runtime_error);
+    value = cache.get_or_load(
+        2, []() -> Cache::LoadResult { return std::make_pair(std::make_shared<uint64_t>(2), 1); });
+    EXPECT_TRUE(value);
+}
+
+// a hot set that is queried before and after a scan over cold keys
+template <typename F>
+uint64_t hot_set_hits(Cache &cache, uint64_t num_hot, uint64_t num_scan, F &&scan) {
+    auto value = std::make_shared<uint64_t>(0);
+    // every hot key is requested twice so it gets admitted under 2Q
+    for (auto round = 0; round < 3; round++) {
+        for (uint64_t i = 0; i < num_hot; i++) {
+            if (!cache.get(i)) cache.put(i, value, 10);
+        }
+    }
+    for (uint64_t i = num_hot; i < num_hot + num_scan; i++) scan(i);
+    uint64_t hits = 0;
+    for (uint64_t i = 0; i < num_hot; i++) {
+        if (cache.exists(i)) hits++;
+    }
+    return hits;
+}
+
+TEST(cache, two_queue) {  // NOLINT
+    constexpr uint64_t num_hot = 5;
+    auto budget = std::make_shared<hermes::MemoryBudget>(100);
+    Cache lru(budget, 1, hermes::CachePolicy::lru);
+    auto put = [](Cache &cache) {
+        return [&cache](uint64_t key) {
+            if (!cache.get(key)) cache.put(key, std::make_shared<uint64_t>(key), 10);
+        };
+    };
+    // a plain scan flushes everything out of the lru
+    EXPECT_EQ(hot_set_hits(lru, num_hot, 100, put(lru)), 0);
+    lru.clear();
+
+    Cache two_queue(budget, 1, hermes::CachePolicy::two_queue);
+    EXPECT_EQ(hot_set_hits(two_queue, num_hot, 100, put(two_queue)), num_hot);
+    EXPECT_LE(budget->usage(), budget->capacity());
+    auto stats = two_queue.stats();
+    EXPECT_GT(stats.probation_bytes, 0);
+    EXPECT_LT(stats.probation_bytes, stats.bytes);
+}
+
+TEST(cache, scan_hint) {  // NOLINT
+    constexpr uint64_t num_hot = 5;
+    auto budget = std::make_shared<hermes::MemoryBudget>(100);
+    Cache cache(budget, 1);
+    auto hits = hot_set_hits(cache, num_hot, 100, [&cache](uint64_t key) {
+        auto value = cache.get_or_load(
+            key,
+            [key]() -> Cache::LoadResult {
+                return std::make_pair(std::make_shared<uint64_t>(key), 10);
+            },
+            hermes::CacheHint::scan);
+        EXPECT_EQ(**value, key);
+        // the entry the scan is on stays in the cache
+        EXPECT_TRUE(cache.exists(key));
+    });
+    EXPECT_EQ(hits, num_hot);
+
+    // a regular access takes the entry out of probation
+    auto probation_bytes = cache.stats().probation_bytes;
+    EXPECT_GT(probation_bytes, 0);
+    cache.get(num_hot + 99);
+    EXPECT_EQ(cache.stats().probation_bytes, probation_bytes - 10);
+}
+
+#ifdef PERFORMANCE_TEST
+
+TEST(cache, mixed_workload_performance) {  // NOLINT
+    // point queries over a skewed hot set, interleaved with full scans over a data set that is
+    // much larger than the budget. each miss stands for a row group decode
+    static constexpr uint64_t entry_size = 1 << 20;
+    static constexpr uint64_t num_entries = 10000;
+    static constexpr uint64_t num_hot = 200;
+    static constexpr uint64_t capacity = 500 * entry_size;
+    static constexpr uint64_t num_rounds = 20;
+    static constexpr uint64_t queries_per_round = 2000;
+
+    auto run = [](hermes::CachePolicy policy, hermes::CacheHint scan_hint) {
+        auto budget = std::make_shared<hermes::MemoryBudget>(capacity);
+        Cache cache(budget, Cache::default_num_shards, policy);
+        auto value = std::make_shared<uint64_t>(0);
+        uint64_t seed = 42;
+        uint64_t query_hits = 0;
+        auto start = std::chrono::system_clock::now();
+        for (uint64_t round = 0; round < num_rounds; round++) {
+            for (uint64_t i = 0; i < queries_per_round; i++) {
+                seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+                // squaring a uniform number skews the queries towards the low keys
+                auto r = static_cast<double>(seed >> 11u) / static_cast<double>(1ull << 53u);
+                auto key = static_cast<uint64_t>(r * r * num_hot);
+                if (cache.get(key)) {
+                    query_hits++;
+                } else {
+                    cache.put(key, value, entry_size);
+                }
+            }
+            for (uint64_t key = 0; key < num_entries; key++) {
+                if (!cache.get(key, scan_hint)) cache.put(key, value, entry_size, scan_hint);
+            }
+        }
+        auto end = std::chrono::system_clock::now();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+        return std::make_pair(static_cast<double>(query_hits) / (num_rounds * queries_per_round),
+                              ms);
+    };
+
+    auto report = [&run](const std::string &name, hermes::CachePolicy policy,
+                         hermes::CacheHint hint) {
+        auto [hit_ratio, ms] = run(policy, hint);
+        std::cout << name << ": point query hit ratio " << hit_ratio << ", " << ms << " ms"
+                  << std::endl;
+        return hit_ratio;
+    };
+    auto lru = report("lru", hermes::CachePolicy::lru, hermes::CacheHint::normal);
+    auto two_queue = report("2q", hermes::CachePolicy::two_queue, hermes::CacheHint::normal);
+    auto lru_scan = report("lru + scan hint", hermes::CachePolicy::lru, hermes::CacheHint::scan);
+    report("2q + scan hint", hermes::CachePolicy::two_queue, hermes::CacheHint::scan);
+    EXPECT_GT(two_queue, lru);
+    EXPECT_GT(lru_scan, lru);
+}
+
+#endif
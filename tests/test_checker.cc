@@ -53,3 +53,62 @@ TEST_F(CheckerTest, check2_except) {  // NOLINT
     Checker2 checker(true);
     EXPECT_THROW(checker.run(name, loader), hermes::CheckerAssertion);
 }
+
+class Checker3 : public hermes::Checker {
+public:
+    void check(const hermes::TransactionData &transaction_data,
+               const std::shared_ptr<hermes::QueryHelper> &) override {
+        std::lock_guard guard(mutex);
+        ids.emplace_back(transaction_data.transaction->id());
+    }
+
+    std::mutex mutex;
+    std::vector<uint64_t> ids;
+};
+
+TEST_F(CheckerTest, check_morsel) {  // NOLINT
+    // every transaction is checked exactly once no matter how the stream is split
+    for (auto morsel_size : {1u, 3u, 1000000u}) {
+        Checker3 checker;
+        checker.set_morsel_size(morsel_size);
+        checker.run(name, loader);
+        std::sort(checker.ids.begin(), checker.ids.end());
+        EXPECT_EQ(std::adjacent_find(checker.ids.begin(), checker.ids.end()), checker.ids.end());
+        EXPECT_EQ(checker.ids.size(), num_transaction_batch * num_events / 10);
+    }
+}
+
+class Checker4 : public hermes::Checker {
+public:
+    Checker4() { stateless_ = false; }
+
+    void check(const hermes::TransactionData &transaction_data,
+               const std::shared_ptr<hermes::QueryHelper> &) override {
+        auto value = *transaction_data.events->front()->get_value<uint64_t>("value");
+        std::lock_guard guard(mutex);
+        ids[value].emplace_back(transaction_data.transaction->id());
+    }
+
+    std::mutex mutex;
+    std::map<uint64_t, std::vector<uint64_t>> ids;
+};
+
+TEST_F(CheckerTest, check_partition) {  // NOLINT
+    Checker4 linear;
+    linear.run(name, loader);
+    EXPECT_FALSE(linear.partitioned());
+
+    // each key has to see the same transactions in the same order as the linear run
+    Checker4 by_name;
+    by_name.set_partition_key("value");
+    by_name.set_morsel_size(7);
+    by_name.run(name, loader);
+    EXPECT_EQ(by_name.ids, linear.ids);
+
+    Checker4 by_func;
+    by_func.set_partition_key([](const hermes::TransactionData &data) {
+        return *data.events->front()->get_value<uint64_t>("value") % 3;
+    });
+    by_func.run(name, loader);
+    EXPECT_EQ(by_func.ids, linear.ids);
+}
@@ -1,6 +1,11 @@
+#include <chrono>
 #include <fstream>
+#include <map>
+#include <set>
+#include <thread>
 
 #include "arrow.hh"
+#include "arrow/api.h"
 #include "event.hh"
 #include "fmt/format.h"
 #include "gtest/gtest.h"
@@ -26,6 +31,129 @@ TEST(event, event_set_get) {  // NOLINT
     EXPECT_EQ(*v2, "42");
 }
 
+TEST(event, event_id) {  // NOLINT
+    // ids are unique across threads and each thread gets them in dense blocks
+    constexpr uint64_t num_threads = 4;
+    constexpr uint64_t num_events = 5000;
+    std::vector<std::vector<uint64_t>> ids(num_threads);
+    std::vector<std::thread> threads;
+    for (uint64_t i = 0; i < num_threads; i++) {
+        threads.emplace_back([&ids, i]() {
+            for (uint64_t j = 0; j < num_events; j++) ids[i].emplace_back(hermes::Event(j).id());
+        });
+    }
+    for (auto &t : threads) t.join();
+
+    std::set<uint64_t> all_ids;
+    for (auto const &thread_ids : ids) {
+        std::set<uint64_t> blocks;
+        for (auto id : thread_ids) {
+            all_ids.emplace(id);
+            blocks.emplace(id / hermes::IdAllocator::block_size);
+        }
+        EXPECT_TRUE(std::is_sorted(thread_ids.begin(), thread_ids.end()));
+        EXPECT_LE(blocks.size(), num_events / hermes::IdAllocator::block_size + 1);
+    }
+    EXPECT_EQ(all_ids.size(), num_threads * num_events);
+
+    hermes::Event::reset_id();
+    EXPECT_EQ(hermes::Event(0).id(), 0);
+    EXPECT_EQ(hermes::Event(0).id(), 1);
+}
+
+TEST(event_batch, time_index) {  // NOLINT
+    hermes::EventBatch batch;
+    // two events per timestamp
+    for (uint64_t i = 0; i < 100; i++) {
+        batch.emplace_back(std::make_shared<hermes::Event>(i / 2 + 10));
+    }
+    EXPECT_EQ(batch.lower_bound(0), batch.begin());
+    EXPECT_EQ(batch.lower_bound(20), batch.begin() + 20);
+    EXPECT_EQ(batch.upper_bound(20), batch.begin() + 22);
+    EXPECT_EQ(batch.lower_bound(60), batch.end());
+    EXPECT_EQ(batch.upper_bound(59), batch.end());
+
+    // the index follows the batch when events are added
+    batch.emplace_back(std::make_shared<hermes::Event>(60));
+    EXPECT_EQ(batch.lower_bound(60), batch.begin() + 100);
+}
+
+TEST(event_batch, move_to) {  // NOLINT
+    hermes::EventBatch batch;
+    auto e1 = std::make_shared<hermes::Event>(0);
+    batch.emplace_back(e1);
+    EXPECT_EQ(batch.get_event(e1->id()), e1.get());
+
+    hermes::EventBatch other;
+    batch.move_to(other);
+    EXPECT_TRUE(batch.empty());
+    EXPECT_EQ(other.get_event(e1->id()), e1.get());
+
+    // the id index is rebuilt for the new content
+    auto e2 = std::make_shared<hermes::Event>(1);
+    batch.emplace_back(e2);
+    EXPECT_FALSE(batch.contains(e1->id()));
+    EXPECT_EQ(batch.get_event(e2->id()), e2.get());
+}
+
+TEST(event, event_schema) {  // NOLINT
+    hermes::Event a(0), b(1);
+    a.add_value<uint64_t>("v1", 1);
+    a.add_value("v2", "a");
+    b.add_value("v2", "b");
+    b.add_value<uint64_t>("v1", 2);
+    // the insertion order does not matter
+    EXPECT_EQ(a.schema_id(), b.schema_id());
+    EXPECT_EQ(&a.schema(), &b.schema());
+    EXPECT_EQ(a.schema().name(0), "v1");
+    EXPECT_EQ(*b.get_value<uint64_t>("v1"), 2);
+
+    // changing a type moves the event to a different schema
+    b.add_value<uint32_t>("v1", 2);
+    EXPECT_NE(a.schema_id(), b.schema_id());
+    EXPECT_EQ(*b.get_value<uint32_t>("v1"), 2);
+    b.add_value<uint64_t>("v1", 3);
+    EXPECT_EQ(a.schema_id(), b.schema_id());
+
+    EXPECT_TRUE(a.remove_value("v1"));
+    EXPECT_FALSE(a.has_value("v1"));
+    EXPECT_EQ(*a.get_value<std::string>("v2"), "a");
+    EXPECT_EQ(a.schema().size(), 1);
+
+    hermes::EventBatch batch;
+    batch.emplace_back(std::make_shared<hermes::Event>(b));
+    batch.emplace_back(std::make_shared<hermes::Event>(a));
+    EXPECT_FALSE(batch.validate());
+    a.add_value<uint64_t>("v1", 4);
+    batch[1] = std::make_shared<hermes::Event>(a);
+    EXPECT_TRUE(batch.validate());
+}
+
+TEST(event, event_fixed_values) {  // NOLINT
+    hermes::Event e("test", 1);
+    e.add_value<uint64_t>(hermes::Event::TIME_NAME, 2);
+    e.add_value<uint64_t>("v", 3);
+    EXPECT_EQ(e.time(), 2);
+    EXPECT_EQ(*e.get_value<uint64_t>(hermes::Event::TIME_NAME), 2);
+    EXPECT_EQ(*e.get_value<uint64_t>(hermes::Event::ID_NAME), e.id());
+    EXPECT_EQ(*e.get_value<std::string>(hermes::Event::NAME_NAME), "test");
+    EXPECT_FALSE(e.remove_value(hermes::Event::NAME_NAME));
+    EXPECT_TRUE(e.has_value(hermes::Event::ID_NAME));
+    // fixed values are not part of the schema but are still reported by values()
+    EXPECT_EQ(e.schema().size(), 1);
+    auto values = e.values();
+    EXPECT_EQ(values.size(), 4);
+    EXPECT_EQ(std::get<uint64_t>(values.at(hermes::Event::TIME_NAME)), 2);
+    EXPECT_EQ(std::get<std::string>(values.at(hermes::Event::NAME_NAME)), "test");
+
+    // the visitor sees the same values without building a map
+    std::map<std::string, hermes::AttributeValue> visited;
+    e.for_each_value([&visited](const char *name, const auto &value) {
+        visited.emplace(name, hermes::AttributeValue(value));
+    });
+    EXPECT_EQ(visited, values);
+}
+
 TEST(event_batch, serilizattion) {  // NOLINT
     // create random events
     hermes::EventBatch batch;
@@ -54,6 +182,72 @@ TEST(event_batch, serilizattion) {  // NOLINT
     EXPECT_EQ(*event->get_value<uint32_t>("uint32_t"), 43 + 42);
 }
 
+TEST(event_batch, serialization_mismatch) {  // NOLINT
+    // same number of attributes, but different names
+    hermes::EventBatch batch;
+    auto e1 = std::make_shared<hermes::Event>(0);
+    e1->add_value<uint64_t>("a", 1);
+    auto e2 = std::make_shared<hermes::Event>(1);
+    e2->add_value<uint64_t>("b", 2);
+    batch.emplace_back(e1);
+    batch.emplace_back(e2);
+    EXPECT_FALSE(batch.validate());
+
+    auto [record, schema] = batch.serialize();
+    auto index = schema->GetFieldIndex("a");
+    EXPECT_GE(index, 0);
+    EXPECT_EQ(schema->GetFieldIndex("b"), -1);
+    EXPECT_FALSE(record->column(index)->IsNull(0));
+    EXPECT_TRUE(record->column(index)->IsNull(1));
+    // time is always there
+    EXPECT_FALSE(record->column(schema->GetFieldIndex("time"))->IsNull(1));
+}
+
+TEST(event_batch, columnar) {  // NOLINT
+    hermes::EventBatch batch;
+    auto constexpr num_events = 100;
+    for (auto i = 0; i < num_events; i++) {
+        auto event = std::make_unique<hermes::Event>(i / 2);
+        event->add_value("str", "this is str " + std::to_string(i));
+        event->add_value<uint16_t>("uint16_t", 42 + i);
+        event->add_value<bool>("bool", i % 2);
+        batch.emplace_back(std::move(event));
+    }
+
+    auto [record, schema] = batch.serialize();
+    auto table = hermes::deserialize(hermes::serialize(record, schema));
+    auto columnar = hermes::ColumnarEventBatch::deserialize(table);
+    EXPECT_TRUE(columnar);
+    EXPECT_EQ(columnar->size(), batch.size());
+
+    auto const event = (*columnar)[42];
+    EXPECT_EQ(event.time(), 21);
+    EXPECT_EQ(event.id(), batch[42]->id());
+    EXPECT_EQ(*event.get_value<std::string>("str"), "this is str 42");
+    EXPECT_EQ(*event.get_value<uint16_t>("uint16_t"), 42 + 42);
+    EXPECT_FALSE(*event.get_value<bool>("bool"));
+    // wrong type or missing column
+    EXPECT_FALSE(event.get_value<uint32_t>("uint16_t"));
+    EXPECT_FALSE(event.get_value<uint16_t>("missing"));
+
+    EXPECT_EQ(columnar->lower_bound(21), 42);
+    EXPECT_EQ(columnar->upper_bound(21), 44);
+    EXPECT_EQ(columnar->upper_bound(num_events), num_events);
+
+    uint64_t count = 0;
+    for (auto const &e : *columnar) {
+        EXPECT_EQ(e.time(), count / 2);
+        count++;
+    }
+    EXPECT_EQ(count, num_events);
+
+    auto e = event.materialize();
+    EXPECT_EQ(e->id(), event.id());
+    EXPECT_EQ(*e->get_value<uint16_t>("uint16_t"), 42 + 42);
+    auto events = columnar->materialize();
+    EXPECT_EQ(events->size(), num_events);
+}
+
 TEST(event_batch, where) {  // NOLINT
     hermes::EventBatch batch;
 
@@ -99,3 +293,156 @@ TEST(event, log_parsing) {  // NOLINT
     EXPECT_EQ(event->time(), 42);
     EXPECT_EQ(*event->get_value<std::string>("value"), "AAA");
 }
+
+#ifdef PERFORMANCE_TEST
+
+template <typename F>
+double measure_per_row(uint64_t num_rows, F &&func) {
+    auto start = std::chrono::system_clock::now();
+    func();
+    auto end = std::chrono::system_clock::now();
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+    return static_cast<double>(ns.count()) / static_cast<double>(num_rows);
+}
+
+TEST(event_batch, decode_performance) {  // NOLINT
+    hermes::EventBatch batch;
+    auto constexpr num_events = 1000000;
+    for (auto i = 0; i < num_events; i++) {
+        auto event = std::make_shared<hermes::Event>(i);
+        event->add_value("str", "this is str " + std::to_string(i % 100));
+        event->add_value<uint32_t>("uint32_t", i);
+        event->add_value<bool>("bool", i % 2);
+        batch.emplace_back(event);
+    }
+    auto [record, schema] = batch.serialize();
+    auto table = hermes::deserialize(hermes::serialize(record, schema));
+
+    // per-cell scalar decode, which is how deserialize used to work
+    uint64_t checksum = 0;
+    auto scalar_cost = measure_per_row(num_events, [&]() {
+        for (auto i = 0; i < table->num_columns(); i++) {
+            auto const &column = table->column(i)->chunk(0);
+            auto type = column->type();
+            for (int64_t j = 0; j < column->length(); j++) {
+                auto v = *column->GetScalar(j);
+                if (type->Equals(arrow::utf8())) {
+                    checksum += hermes::get_string(v).size();
+                } else if (type->Equals(arrow::uint32())) {
+                    checksum += hermes::get_uint32(v);
+                } else if (type->Equals(arrow::uint64())) {
+                    checksum += hermes::get_uint64(v);
+                } else if (type->Equals(arrow::boolean())) {
+                    checksum += hermes::get_bool(v);
+                }
+            }
+        }
+    });
+
+    std::unique_ptr<hermes::EventBatch> events;
+    auto bulk_cost = measure_per_row(
+        num_events, [&]() { events = hermes::EventBatch::deserialize(table.get()); });
+
+    std::unique_ptr<hermes::ColumnarEventBatch> columnar;
+    auto columnar_cost = measure_per_row(
+        num_events, [&]() { columnar = hermes::ColumnarEventBatch::deserialize(table); });
+
+    std::cout << "Scalar decode: " << scalar_cost << " ns/row (values only)" << std::endl
+              << "Bulk decode: " << bulk_cost << " ns/row" << std::endl
+              << "Columnar decode: " << columnar_cost << " ns/row" << std::endl;
+    EXPECT_GT(checksum, 0);
+    EXPECT_EQ(events->size(), num_events);
+    EXPECT_EQ(columnar->size(), num_events);
+}
+
+TEST(event_batch, time_index_performance) {  // NOLINT
+    auto constexpr num_events = 1000000;
+    hermes::EventBatch batch;
+    for (auto i = 0; i < num_events; i++) {
+        batch.emplace_back(std::make_shared<hermes::Event>(i / 4));
+    }
+
+    // the tree index the batch used to build
+    std::map<uint64_t, hermes::EventBatch::iterator> lower, upper;
+    auto map_cost = measure_per_row(num_events, [&]() {
+        for (auto it = batch.begin(); it != batch.end(); it++) {
+            lower.try_emplace((*it)->time(), it);
+            upper[(*it)->time()] = it;
+        }
+    });
+    auto array_cost = measure_per_row(num_events, [&]() { (void)batch.lower_bound(0); });
+
+    uint64_t map_sum = 0, array_sum = 0;
+    auto map_query_cost = measure_per_row(num_events, [&]() {
+        for (auto i = 0; i < num_events; i++) {
+            map_sum += std::distance(batch.begin(), lower.lower_bound(i / 4)->second);
+        }
+    });
+    auto array_query_cost = measure_per_row(num_events, [&]() {
+        for (auto i = 0; i < num_events; i++) {
+            array_sum += std::distance(batch.begin(), batch.lower_bound(i / 4));
+        }
+    });
+
+    std::cout << "Map index build: " << map_cost << " ns/event, query: " << map_query_cost
+              << " ns" << std::endl
+              << "Array index build: " << array_cost << " ns/event, query: " << array_query_cost
+              << " ns" << std::endl;
+    EXPECT_EQ(map_sum, array_sum);
+}
+
+TEST(event_batch, sort_merge_performance) {  // NOLINT
+    auto constexpr num_events = 10000000;
+    auto constexpr num_batches = 8;
+    // the same values stored the way events used to keep time, id and name
+    using ValueMap = std::map<std::string, hermes::AttributeValue>;
+    std::vector<std::vector<std::shared_ptr<ValueMap>>> maps(num_batches);
+    std::vector<hermes::EventBatch> batches(num_batches);
+    for (auto i = 0; i < num_events; i++) {
+        // times are interleaved across batches and reversed inside each batch
+        auto time = num_events - i;
+        auto event = std::make_shared<hermes::Event>("event", time);
+        event->add_value<uint32_t>("value", i);
+        maps[i % num_batches].emplace_back(std::make_shared<ValueMap>(event->values()));
+        batches[i % num_batches].emplace_back(event);
+    }
+
+    auto map_time = [](const std::shared_ptr<ValueMap> &m) {
+        return std::get<uint64_t>(m->at(hermes::Event::TIME_NAME));
+    };
+    auto map_cost = measure_per_row(num_events, [&]() {
+        for (auto &batch : maps) {
+            std::sort(batch.begin(), batch.end(), [&](auto const &a, auto const &b) {
+                return map_time(a) < map_time(b);
+            });
+        }
+        std::vector<std::shared_ptr<ValueMap>> merged;
+        for (auto const &batch : maps) {
+            auto size = merged.size();
+            merged.insert(merged.end(), batch.begin(), batch.end());
+            std::inplace_merge(merged.begin(), merged.begin() + size, merged.end(),
+                               [&](auto const &a, auto const &b) {
+                                   return map_time(a) < map_time(b);
+                               });
+        }
+    });
+
+    std::vector<std::shared_ptr<hermes::Event>> merged;
+    auto field_cost = measure_per_row(num_events, [&]() {
+        for (auto &batch : batches) batch.sort();
+        for (auto const &batch : batches) {
+            auto size = merged.size();
+            merged.insert(merged.end(), batch.begin(), batch.end());
+            std::inplace_merge(merged.begin(), merged.begin() + size, merged.end(),
+                               [](auto const &a, auto const &b) { return a->time() < b->time(); });
+        }
+    });
+
+    std::cout << "Value map sort + merge: " << map_cost << " ns/event" << std::endl
+              << "Fixed field sort + merge: " << field_cost << " ns/event" << std::endl;
+    EXPECT_EQ(merged.size(), num_events);
+    EXPECT_TRUE(std::is_sorted(merged.begin(), merged.end(),
+                               [](auto const &a, auto const &b) { return a->time() < b->time(); }));
+}
+
+#endif
@@ -0,0 +1,57 @@
+#include <atomic>
+#include <numeric>
+
+#include "gtest/gtest.h"
+#include "process.hh"
+
+TEST(executor, parallel_for) {  // NOLINT
+    hermes::Executor executor(4);
+    constexpr uint64_t size = 10000;
+    std::vector<uint64_t> values(size, 0);
+    executor.parallel_for(0, size, [&values](uint64_t i) { values[i] = i; });
+    for (uint64_t i = 0; i < size; i++) EXPECT_EQ(values[i], i);
+}
+
+TEST(executor, nested) {  // NOLINT
+    // a single worker has to run the inner loops while it waits for them
+    for (auto num_threads : {1, 4}) {
+        hermes::Executor executor(num_threads);
+        std::atomic<uint64_t> sum = 0;
+        executor.parallel_for(0, 16, [&executor, &sum](uint64_t i) {
+            executor.parallel_for(0, 16, [&sum, i](uint64_t j) { sum += i * 16 + j; });
+        });
+        EXPECT_EQ(sum, 256 * 255 / 2);
+    }
+}
+
+TEST(executor, submit) {  // NOLINT
+    hermes::Executor executor(2);
+    std::vector<std::future<uint64_t>> futures;
+    for (uint64_t i = 0; i < 100; i++) {
+        futures.emplace_back(executor.submit([i]() { return i * 2; }));
+    }
+    uint64_t sum = 0;
+    for (auto &future : futures) sum += executor.get(future);
+    EXPECT_EQ(sum, 99 * 100);
+
+    // a task waiting for another one doesn't block the only worker
+    hermes::Executor single(1);
+    auto outer = single.submit([&single]() {
+        auto inner = single.submit([]() { return 42; });
+        return single.get(inner);
+    });
+    EXPECT_EQ(outer.get(), 42);
+}
+
+TEST(executor, exception) {  // NOLINT
+    hermes::Executor executor(2);
+    std::atomic<uint64_t> count = 0;
+    EXPECT_THROW(executor.parallel_for(0, 100,
+                                       [&count](uint64_t i) {
+                                           count++;
+                                           if (i == 42) throw std::runtime_error("42");
+                                       }),
+                 std::runtime_error);
+    // the remaining iterations still run
+    EXPECT_EQ(count, 100);
+}
@@ -1,6 +1,10 @@
 #include <chrono>
+#include <filesystem>
+#include <fstream>
 
 #include "arrow.hh"
+#include "arrow/table.h"
+#include "fmt/format.h"
 #include "gtest/gtest.h"
 #include "loader.hh"
 #include "logger.hh"
@@ -19,16 +23,25 @@ public:
             event_time_ = event->time();
         }
         EXPECT_EQ(*event->get_value<uint32_t>("value"), event->time());
+        check_order(event->time());
     }
 
     void on_message(const std::string &,
                     const std::shared_ptr<hermes::Transaction> &transaction) override {
         transactions.emplace_back(transaction);
+        check_order(transaction->start_time());
+    }
+
+    // events and transactions are merged into a single time order
+    void check_order(uint64_t time) {
+        EXPECT_GE(time, last_time_);
+        last_time_ = time;
     }
 
     std::vector<std::shared_ptr<hermes::Event>> events;
     std::vector<std::shared_ptr<hermes::Transaction>> transactions;
     std::optional<uint64_t> event_time_;
+    uint64_t last_time_ = 0;
 };
 
 class LoaderTest : public ::testing::Test {
@@ -102,6 +115,28 @@ TEST_F(LoaderTest, stream) {  // NOLINT
     EXPECT_EQ(sub->transactions.size(), num_events * 2 / chunk_size);
 }
 
+TEST_F(LoaderTest, stream_window) {  // NOLINT
+    hermes::Loader loader(dir.path());
+    auto sub = std::make_shared<StreamSubSubscriber>();
+    sub->subscribe(hermes::MessageBus::default_bus(), event_name);
+    hermes::StreamOptions options;
+    options.topics = {"dummy*"};
+    options.start_time = num_events + 20;
+    options.end_time = num_events + 29;
+    options.stream_transactions = false;
+    loader.stream(options);
+    EXPECT_EQ(sub->events.size(), 10);
+    EXPECT_EQ(sub->events.front()->time(), num_events + 20);
+    EXPECT_TRUE(sub->transactions.empty());
+    // only the second event row group overlaps with the window
+    EXPECT_EQ(loader.cache_stats(hermes::FileInfo::FileType::event).misses, 1);
+
+    // unknown topics don't load anything
+    options.topics = {"dummy2"};
+    loader.stream(options);
+    EXPECT_EQ(sub->events.size(), 10);
+}
+
 TEST_F(LoaderTest, names) {  // NOLINT
     hermes::Loader loader(dir.path());
     auto names = loader.get_event_names();
@@ -132,6 +167,25 @@ TEST_F(LoaderTest, stream_iter) {  // NOLINT
     EXPECT_EQ(num_trans, num_events * 2 / chunk_size);
 }
 
+TEST_F(LoaderTest, batch_events) {  // NOLINT
+    hermes::Loader loader(dir.path());
+    auto batch = loader.get_transactions(event_name, 0, std::numeric_limits<uint64_t>::max());
+    std::vector<std::shared_ptr<hermes::Transaction>> transactions(batch->begin(), batch->end());
+    // unknown transactions are allowed
+    transactions.emplace_back(nullptr);
+    auto events = loader.get_events(transactions);
+    EXPECT_EQ(events.size(), transactions.size());
+    EXPECT_TRUE(events.back()->empty());
+    for (uint64_t i = 0; i < batch->size(); i++) {
+        auto expected = loader.get_events(*transactions[i]);
+        EXPECT_EQ(events[i]->size(), chunk_size);
+        for (uint64_t j = 0; j < expected->size(); j++) {
+            EXPECT_NE((*events[i])[j], nullptr);
+            EXPECT_EQ((*events[i])[j], (*expected)[j]);
+        }
+    }
+}
+
 TEST_F(LoaderTest, filter_stream_iter) {  // NOLINT
     hermes::Loader loader(dir.path());
     auto stream = loader.get_transaction_stream(event_name);
@@ -147,7 +201,22 @@ TEST_F(LoaderTest, filter_stream_iter) {  // NOLINT
     }
     for (uint64_t i = 0; i < ids.size(); i++) {
         EXPECT_EQ(ids[i], i * 2);
+        // random access has to agree with sequential access
+        EXPECT_EQ((*(filtered_stream.begin() + i)).transaction->id(), ids[i]);
     }
+
+    // the first table is empty after the filter
+    auto num_transactions = stream->size();
+    auto tail_stream = stream->where([num_transactions](const hermes::TransactionData &data) {
+        return data.transaction->id() >= num_transactions - 2;
+    });
+    EXPECT_EQ(tail_stream.size(), 2);
+    uint64_t num_rows = 0;
+    for (auto const &data : tail_stream) {
+        EXPECT_EQ(data.transaction->id(), num_transactions - 2 + num_rows);
+        num_rows++;
+    }
+    EXPECT_EQ(num_rows, 2);
 }
 
 TEST_F(LoaderTest, filter_stream_iter_cascade) {  // NOLINT
@@ -173,6 +242,195 @@ TEST_F(LoaderTest, filter_stream_iter_cascade) {  // NOLINT
     }
 }
 
+TEST_F(LoaderTest, combine_stream) {  // NOLINT
+    hermes::Loader loader(dir.path());
+    auto stream = loader.get_transaction_stream(event_name);
+    auto even = stream->where([](const hermes::TransactionData &data) -> bool {
+        return data.transaction->id() % 2 == 0;
+    });
+    auto triple = stream->where([](const hermes::TransactionData &data) -> bool {
+        return data.transaction->id() % 3 == 0;
+    });
+    auto get_ids = [](const hermes::TransactionStream &s) {
+        std::vector<uint64_t> ids;
+        for (auto const &data : s) ids.emplace_back(data.transaction->id());
+        return ids;
+    };
+
+    auto both = get_ids(even.intersect(triple));
+    EXPECT_FALSE(both.empty());
+    for (uint64_t i = 0; i < both.size(); i++) EXPECT_EQ(both[i], i * 6);
+
+    auto either = get_ids(even.unite(triple));
+    std::vector<uint64_t> expected;
+    for (uint64_t i = 0; i < stream->size(); i++) {
+        if (i % 2 == 0 || i % 3 == 0) expected.emplace_back(i);
+    }
+    EXPECT_EQ(either, expected);
+
+    // unfiltered streams select everything
+    EXPECT_EQ(get_ids(stream->intersect(triple)), get_ids(triple));
+}
+
+TEST_F(LoaderTest, lazy_row_group) {  // NOLINT
+    hermes::Loader loader(dir.path());
+    // only the footers are read at this point
+    auto const &tables = loader.tables();
+    EXPECT_FALSE(tables.empty());
+    uint64_t num_events_loaded = 0;
+    for (auto const &[info, row_group] : tables) {
+        auto table = loader.load_table(row_group.get());
+        EXPECT_NE(table, nullptr);
+        EXPECT_EQ(table->num_rows(), row_group->num_rows);
+        if (info.first->type == hermes::FileInfo::FileType::event) {
+            num_events_loaded += row_group->num_rows;
+        }
+    }
+    EXPECT_EQ(num_events_loaded, total_num_events);
+}
+
+TEST_F(LoaderTest, manifest) {  // NOLINT
+    // a single manifest instead of one json file per parquet file
+    EXPECT_TRUE(std::filesystem::exists(hermes::Serializer::get_manifest_filename(dir.path())));
+    EXPECT_FALSE(std::filesystem::exists(std::filesystem::path(dir.path()) / "0.json"));
+
+    hermes::Loader loader(dir.path());
+    auto const &tables = loader.tables();
+    EXPECT_FALSE(tables.empty());
+    for (auto const &[info, row_group] : tables) {
+        // planning does not need any footer
+        EXPECT_EQ(info.first->reader, nullptr);
+        EXPECT_NE(info.first->schema, nullptr);
+        EXPECT_LE(row_group->min_time, row_group->max_time);
+        EXPECT_LE(row_group->min_id, row_group->max_id);
+    }
+
+    // only the second event chunk overlaps with this range
+    auto events = loader.get_events(event_name, num_events + 10, num_events + 20);
+    EXPECT_EQ(events->size(), num_events);
+    std::set<const hermes::FileInfo *> opened;
+    const hermes::RowGroupInfo *transaction_group = nullptr;
+    for (auto const &[info, row_group] : tables) {
+        if (info.first->reader) opened.emplace(info.first);
+        if (info.first->type == hermes::FileInfo::FileType::transaction) {
+            transaction_group = row_group.get();
+        }
+    }
+    EXPECT_EQ(opened.size(), 1);
+
+    // id ranges are in the manifest as well
+    EXPECT_NE(transaction_group, nullptr);
+    auto t = loader.get_transaction(transaction_group->max_id);
+    EXPECT_NE(t, nullptr);
+    EXPECT_EQ(t->id(), transaction_group->max_id);
+}
+
+void write_events(const std::string &dir, bool override, uint64_t start, uint64_t num_events) {
+    hermes::Serializer s(dir, override);
+    hermes::EventBatch batch;
+    batch.set_name("test");
+    for (auto i = start; i < start + num_events; i++) {
+        auto e = std::make_shared<hermes::Event>(i);
+        e->add_value<uint32_t>("value", i);
+        batch.emplace_back(e);
+    }
+    EXPECT_TRUE(s.serialize(batch));
+    EXPECT_TRUE(s.finalize());
+}
+
+TEST(loader, append_checkpoint_dir) {  // NOLINT
+    TempDirectory dir;
+    constexpr auto num_events = 10;
+    write_events(dir.path(), true, 0, num_events);
+    // turn it into the layout used before the manifest
+    std::filesystem::remove(hermes::Serializer::get_manifest_filename(dir.path()));
+    auto path = std::filesystem::path(dir.path());
+    std::ofstream(path / "0.json") << R"({"parquet": "0.parquet", "type": "event", )"
+                                   << R"("name": "test"})";
+    std::ofstream(hermes::Serializer::get_checkpoint_filename(dir.path()))
+        << R"({"files": ["0.json"]})";
+
+    // the new manifest only lists the appended file
+    write_events(dir.path(), false, num_events, num_events);
+    hermes::Loader loader(dir.path());
+    auto events = loader.get_events("test", 0, num_events * 2);
+    EXPECT_EQ(events->size(), num_events * 2);
+}
+
+TEST(loader, override_checkpoint_dir) {  // NOLINT
+    TempDirectory dir;
+    constexpr auto num_events = 10;
+    write_events(dir.path(), true, 0, num_events);
+    write_events(dir.path(), false, num_events, num_events);
+    // turn it into the layout used before the manifest, with two files
+    std::filesystem::remove(hermes::Serializer::get_manifest_filename(dir.path()));
+    auto path = std::filesystem::path(dir.path());
+    for (auto i = 0; i < 2; i++) {
+        std::ofstream(path / fmt::format("{0}.json", i))
+            << fmt::format(R"({{"parquet": "{0}.parquet", "type": "event", "name": "test"}})", i);
+    }
+    std::ofstream(hermes::Serializer::get_checkpoint_filename(dir.path()))
+        << R"({"files": ["0.json", "1.json"]})";
+
+    // only overwrites 0.parquet. 1.parquet is stale and must not be loaded
+    write_events(dir.path(), true, num_events * 2, num_events);
+    auto checkpoint = hermes::Serializer::get_checkpoint_filename(dir.path());
+    EXPECT_FALSE(std::filesystem::exists(checkpoint));
+    hermes::Loader loader(dir.path());
+    auto events = loader.get_events("test", 0, num_events * 3);
+    EXPECT_EQ(events->size(), num_events);
+    EXPECT_EQ(events->front()->time(), num_events * 2);
+}
+
+TEST(loader, multiple_dirs) {  // NOLINT
+    // the same file names in a manifest directory and a legacy directory
+    TempDirectory manifest_dir, legacy_dir;
+    constexpr auto num_events = 10;
+    write_events(manifest_dir.path(), true, 0, num_events);
+    write_events(legacy_dir.path(), true, num_events, num_events);
+    std::filesystem::remove(hermes::Serializer::get_manifest_filename(legacy_dir.path()));
+    auto path = std::filesystem::path(legacy_dir.path());
+    std::ofstream(path / "0.json") << R"({"parquet": "0.parquet", "type": "event", )"
+                                   << R"("name": "test"})";
+    std::ofstream(hermes::Serializer::get_checkpoint_filename(legacy_dir.path()))
+        << R"({"files": ["0.json"]})";
+
+    hermes::Loader loader(std::vector<std::string>{manifest_dir.path(), legacy_dir.path()});
+    auto events = loader.get_events("test", 0, num_events * 2);
+    EXPECT_EQ(events->size(), num_events * 2);
+}
+
+TEST(loader, malformed_manifest_row_group) {  // NOLINT
+    TempDirectory dir;
+    constexpr auto num_events = 10;
+    write_events(dir.path(), true, 0, num_events);
+    auto manifest = hermes::Serializer::get_manifest_filename(dir.path());
+    std::ofstream(manifest) << R"({"version": 1, "files": [{"parquet": "0.parquet",)"
+                            << R"("type": "event", "name": "test", "row_groups": [{}]}]})";
+
+    // row groups come from the footer instead
+    hermes::Loader loader(dir.path());
+    auto events = loader.get_events("test", 0, num_events);
+    EXPECT_EQ(events->size(), num_events);
+}
+
+TEST(IntervalIndex, query) {  // NOLINT
+    hermes::IntervalIndex<uint64_t> index;
+    // out of order and one interval that covers others
+    index.add(20, 29, 2);
+    index.add(0, 9, 0);
+    index.add(10, 19, 1);
+    index.add(5, 100, 3);
+    index.add(30, 39, 4);
+    index.build();
+
+    EXPECT_EQ(index.query(12, 15), (std::vector<uint64_t>{3, 1}));
+    EXPECT_EQ(index.query(9, 10), (std::vector<uint64_t>{0, 3, 1}));
+    EXPECT_EQ(index.query(101, 200), (std::vector<uint64_t>{}));
+    EXPECT_EQ(index.query(39, 39), (std::vector<uint64_t>{3, 4}));
+    EXPECT_EQ(index.query(0, std::numeric_limits<uint64_t>::max()).size(), 5);
+}
+
 class S3LoaderTest : public LoaderTest {
     void SetUp() override {
         // only if the port is open
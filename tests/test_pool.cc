@@ -0,0 +1,69 @@
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "pool.hh"
+
+struct PoolObject : public std::enable_shared_from_this<PoolObject> {
+    explicit PoolObject(uint64_t value) : value(value) {}
+    uint64_t value;
+};
+
+TEST(pool, make_pooled) {  // NOLINT
+    std::vector<std::shared_ptr<PoolObject>> objects;
+    for (uint64_t round = 0; round < 4; round++) {
+        for (uint64_t i = 0; i < 1000; i++) {
+            objects.emplace_back(hermes::make_pooled<PoolObject>(i));
+        }
+        for (uint64_t i = 0; i < 1000; i++) {
+            EXPECT_EQ(objects[i]->value, i);
+            EXPECT_EQ(objects[i]->shared_from_this(), objects[i]);
+        }
+        objects.clear();
+    }
+}
+
+TEST(pool, recycle) {  // NOLINT
+    using Pool = hermes::BlockPool<48, 16>;
+    auto &pool = Pool::get();
+    std::vector<void *> blocks;
+    for (uint64_t i = 0; i < 10000; i++) {
+        blocks.emplace_back(pool.allocate());
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(blocks.back()) % 16, 0);
+    }
+    auto capacity = pool.capacity();
+    for (auto *block : blocks) pool.deallocate(block);
+    blocks.clear();
+
+    // freed blocks are handed out again instead of growing the pool
+    for (uint64_t i = 0; i < 10000; i++) blocks.emplace_back(pool.allocate());
+    EXPECT_EQ(pool.capacity(), capacity);
+    for (auto *block : blocks) pool.deallocate(block);
+}
+
+TEST(pool, cross_thread) {  // NOLINT
+    // blocks allocated by one thread and released by another, like events handed to the
+    // serializer
+    using Pool = hermes::BlockPool<64, 8>;
+    auto &pool = Pool::get();
+    constexpr uint64_t num_rounds = 50;
+    constexpr uint64_t num_blocks = 2000;
+    for (uint64_t round = 0; round < num_rounds; round++) {
+        std::vector<void *> blocks;
+        for (uint64_t i = 0; i < num_blocks; i++) {
+            auto *block = static_cast<uint64_t *>(pool.allocate());
+            *block = i;
+            blocks.emplace_back(block);
+        }
+        std::thread consumer([&pool, &blocks]() {
+            uint64_t sum = 0;
+            for (auto *block : blocks) {
+                sum += *static_cast<uint64_t *>(block);
+                pool.deallocate(block);
+            }
+            EXPECT_EQ(sum, num_blocks * (num_blocks - 1) / 2);
+        });
+        consumer.join();
+    }
+    // the released blocks are recycled, so the pool stays at a couple rounds worth of blocks
+    EXPECT_LT(pool.capacity(), 4 * num_blocks);
+}
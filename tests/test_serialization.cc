@@ -1,5 +1,9 @@
+#include <chrono>
+#include <thread>
+
 #include "arrow.hh"
 #include "event.hh"
+#include "fmt/format.h"
 #include "gtest/gtest.h"
 #include "loader.hh"
 #include "serializer.hh"
@@ -74,6 +78,101 @@ TEST(serialization, multiple_event_batches) {  // NOLINT
     EXPECT_EQ( event->name(), "test");
 }
 
+TEST(serialization, async) {  // NOLINT
+    TempDirectory dir;
+
+    hermes::Serializer s(dir.path());
+    // small queue depth to exercise backpressure
+    s.set_async(true, 1);
+    EXPECT_TRUE(s.async());
+
+    hermes::EventBatch batch;
+    batch.set_name("test");
+    constexpr auto num_event = 1000;
+    constexpr auto num_batches = 10;
+    uint64_t time = 0;
+    for (auto b = 0; b < num_batches; b++) {
+        for (auto i = 0; i < num_event; i++) {
+            auto e = std::make_shared<hermes::Event>(time++);
+            e->add_value<uint64_t>("value1", i);
+            batch.emplace_back(e);
+        }
+        EXPECT_TRUE(s.serialize(batch));
+        // the content is handed over to the background writer
+        EXPECT_TRUE(batch.empty());
+        EXPECT_EQ(batch.name(), "test");
+    }
+    EXPECT_TRUE(s.finalize());
+
+    hermes::Loader loader(dir.path());
+    auto event_batch = loader.get_events("test", 0, time);
+    EXPECT_EQ(event_batch->size(), num_event * num_batches);
+    // row groups are written in the order they are queued
+    for (uint64_t i = 0; i < event_batch->size(); i++) {
+        EXPECT_EQ((*event_batch)[i]->time(), i);
+    }
+}
+
+TEST(serialization, async_error) {  // NOLINT
+    TempDirectory dir;
+
+    hermes::Serializer s(dir.path());
+    s.set_async(true);
+
+    // events with different attributes fail validation in the background writer
+    hermes::EventBatch batch;
+    auto e1 = std::make_shared<hermes::Event>(0);
+    e1->add_value<uint64_t>("a", 1);
+    auto e2 = std::make_shared<hermes::Event>(1);
+    e2->add_value<uint64_t>("b", 2);
+    batch.emplace_back(e1);
+    batch.emplace_back(e2);
+    EXPECT_TRUE(s.serialize(batch));
+    EXPECT_FALSE(s.finalize());
+
+    // the error is sticky
+    batch.emplace_back(std::make_shared<hermes::Event>(2));
+    EXPECT_FALSE(s.serialize(batch));
+}
+
+TEST(serialization, concurrent) {  // NOLINT
+    constexpr auto num_threads = 4;
+    constexpr auto num_event = 1000;
+    constexpr auto num_batches = 4;
+    for (auto async : {false, true}) {
+        TempDirectory dir;
+        hermes::Serializer s(dir.path());
+        if (async) s.set_async(true, 2, 2);
+
+        std::vector<std::thread> threads;
+        for (auto t = 0; t < num_threads; t++) {
+            threads.emplace_back([&s, t]() {
+                hermes::EventBatch batch;
+                batch.set_name(fmt::format("test{0}", t));
+                uint64_t time = 0;
+                for (auto b = 0; b < num_batches; b++) {
+                    for (auto i = 0; i < num_event; i++) {
+                        batch.emplace_back(std::make_shared<hermes::Event>(time++));
+                    }
+                    s.serialize(batch);
+                    batch.clear();
+                }
+            });
+        }
+        for (auto &thread : threads) thread.join();
+        s.finalize();
+
+        hermes::Loader loader(dir.path());
+        for (auto t = 0; t < num_threads; t++) {
+            auto events = loader.get_events(fmt::format("test{0}", t), 0, num_event * num_batches);
+            EXPECT_EQ(events->size(), num_event * num_batches);
+            for (uint64_t i = 0; i < events->size(); i++) {
+                EXPECT_EQ((*events)[i]->time(), i);
+            }
+        }
+    }
+}
+
 TEST(serialization, transactions) {  // NOLINT
     TempDirectory dir;
 
@@ -246,3 +345,105 @@ TEST(serialization, transaction_group) {  // NOLINT
         EXPECT_GT(group->size(), 0);
     }
 }
+
+TEST(serialization, compression_options) {  // NOLINT
+    TempDirectory dir;
+
+    hermes::Serializer s(dir.path());
+    hermes::SerializerOptions options;
+    options.compression.codec = hermes::CompressionCodec::none;
+    options.column_compression["value1"] = {hermes::CompressionCodec::snappy, std::nullopt};
+    EXPECT_TRUE(s.set_options(options));
+
+    hermes::EventBatch batch;
+    batch.set_name("test");
+    constexpr auto num_event = 1000;
+    for (auto i = 0; i < num_event; i++) {
+        auto e = std::make_shared<hermes::Event>(i);
+        e->add_value<uint64_t>("value1", i);
+        e->add_value<std::string>("value2", std::to_string(i % 4));
+        batch.emplace_back(e);
+    }
+    EXPECT_TRUE(s.serialize(batch));
+    s.finalize();
+
+    hermes::Loader loader(dir.path());
+    auto events = loader.get_events("test", 0, num_event);
+    EXPECT_EQ(events->size(), num_event);
+    EXPECT_EQ(*(*events)[42]->get_value<std::string>("value2"), "2");
+}
+
+#ifdef PERFORMANCE_TEST
+
+TEST(serialization, compression_performance) {  // NOLINT
+    constexpr auto num_events = 1000000;
+    constexpr auto batch_size = 1 << 15;
+    std::vector<std::pair<std::string, hermes::SerializerOptions>> choices;
+    auto add_choice = [&choices](const std::string &name, hermes::CompressionCodec codec,
+                                 std::optional<int> level) {
+        hermes::SerializerOptions options;
+        options.compression = {codec, level};
+        choices.emplace_back(name, options);
+    };
+    add_choice("none", hermes::CompressionCodec::none, std::nullopt);
+    add_choice("snappy", hermes::CompressionCodec::snappy, std::nullopt);
+    add_choice("lz4", hermes::CompressionCodec::lz4, std::nullopt);
+    add_choice("zstd-1", hermes::CompressionCodec::zstd, 1);
+    add_choice("zstd-9", hermes::CompressionCodec::zstd, 9);
+
+    for (auto const &[name, options] : choices) {
+        TempDirectory dir;
+        hermes::Serializer s(dir.path());
+        if (!s.set_options(options)) {
+            std::cout << name << ": not available" << std::endl;
+            continue;
+        }
+
+        hermes::EventBatch batch;
+        batch.set_name("test");
+        bool ok = true;
+        auto start = std::chrono::system_clock::now();
+        for (auto i = 0; i < num_events; i++) {
+            auto e = std::make_shared<hermes::Event>(i);
+            e->add_value<uint32_t>("value", i % 1024);
+            e->add_value<std::string>("cmd", i % 2 ? "READ" : "WRITE");
+            batch.emplace_back(e);
+            if (batch.size() == batch_size) {
+                ok &= s.serialize(batch);
+                batch.clear();
+            }
+        }
+        ok &= s.serialize(batch);
+        s.finalize();
+        auto end = std::chrono::system_clock::now();
+        if (!ok) {
+            std::cout << name << ": failed to serialize" << std::endl;
+            continue;
+        }
+        auto write_sec =
+            static_cast<double>(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()) /
+            1e6;
+
+        uint64_t file_size = 0;
+        for (auto const &entry : fs::directory_iterator(dir.path())) {
+            if (entry.path().extension() == ".parquet") file_size += fs::file_size(entry.path());
+        }
+
+        start = std::chrono::system_clock::now();
+        hermes::Loader loader(dir.path());
+        auto events = loader.get_events("test", 0, num_events);
+        end = std::chrono::system_clock::now();
+        auto read_sec =
+            static_cast<double>(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()) /
+            1e6;
+        EXPECT_EQ(events->size(), num_events);
+
+        std::cout << name << ": write " << num_events / write_sec << " events/s, size "
+                  << file_size << " bytes, read " << num_events / read_sec << " events/s"
+                  << std::endl;
+    }
+}
+
+#endif
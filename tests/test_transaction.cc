@@ -37,6 +37,29 @@ TEST(transaction, serialization) {  // NOLINT
     }
 }
 
+TEST(transaction, serialization_mismatch) {  // NOLINT
+    // same number of attributes, but different names or types
+    hermes::TransactionBatch batch;
+    auto t1 = std::make_shared<hermes::Transaction>(0);
+    t1->add_attr<uint64_t>("a", 1);
+    auto t2 = std::make_shared<hermes::Transaction>(1);
+    t2->add_attr<uint64_t>("b", 2);
+    auto t3 = std::make_shared<hermes::Transaction>(2);
+    t3->add_attr<bool>("a", true);
+    batch.emplace_back(t1);
+    batch.emplace_back(t2);
+    batch.emplace_back(t3);
+
+    auto [record, schema] = batch.serialize();
+    auto index = schema->GetFieldIndex("a");
+    EXPECT_GE(index, 0);
+    EXPECT_EQ(schema->GetFieldIndex("b"), -1);
+    auto const &column = record->column(index);
+    EXPECT_FALSE(column->IsNull(0));
+    EXPECT_TRUE(column->IsNull(1));
+    EXPECT_TRUE(column->IsNull(2));
+}
+
 TEST(transaction_group, serilization) { // NOLINT
     hermes::TransactionGroupBatch batch;
     constexpr auto num_group = 1000;